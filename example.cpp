@@ -3,16 +3,16 @@
 #include <fstream>
 #include <vector>
 #include <numeric>
+#include <set>
 
 #include "mono_wedge.h"
+#include "window_aggregate.h"
 
 struct Sample {
   float value;
   int time;
-
-  bool operator<(const Sample& o) const { return value < o.value; }
-  bool operator>(const Sample& o) const { return value > o.value; }
 };
+
 template <class charT, charT sep>
 class punct_facet : public std::numpunct<charT> {
  protected:
@@ -51,30 +51,26 @@ std::chrono::nanoseconds example(const std::vector<float> &values, bool write_fi
   }
 
   const int rangeSize = 20;
-  mono_wedge::mono_wedge<int, Sample> wedge;
+  mono_wedge::mono_wedge<int, float> wedge;
   std::vector<std::chrono::nanoseconds> durations;
 
   for (auto& sample : samples) {
     TimeGauge timer;
     // Add the new sample to our wedge
-    wedge.max_update(sample.time, sample);
+    wedge.max_update(sample.time, sample.value);
 
-    int removed{};
-    while (wedge.begin()->first <= sample.time - rangeSize) {
-      wedge.pop_front();
-      removed++;
-    }
+    // Pop the samples which have left the range
+    auto removed = wedge.expire_before(sample.time - rangeSize + 1);
 
     // The maximum value is at the front of the (never empty) wedge.
-    auto maximumInRange = wedge.begin();
+    const float& maximum_in_range = wedge.front_value();
     durations.push_back(timer.Stop());
 
-    auto maximum_in_range = *maximumInRange;
     if (write_console) {
       std::cout << sample << "\n   Wedge: ";
 
-      for (auto& i : wedge) {
-        std::cout << i.second << ' ';
+      for (const auto& i : wedge) {
+        std::cout << i.first << '/' << i.second << ' ';
       }
       std::cout << "\n";
       if (removed) {
@@ -83,7 +79,7 @@ std::chrono::nanoseconds example(const std::vector<float> &values, bool write_fi
     }
 
     if (write_file) {
-      out_file << sample.time << ';' << sample.value << ';' << maximumInRange->second.value << '\n';
+      out_file << sample.time << ';' << sample.value << ';' << maximum_in_range << '\n';
     }
   }
 
@@ -91,6 +87,92 @@ std::chrono::nanoseconds example(const std::vector<float> &values, bool write_fi
   return total_time;
 }
 
+// Rolling four largest values over a range, with the top-k wedge or with a multiset of the range.
+std::chrono::nanoseconds topk_example(const std::vector<float>& values, int rangeSize, float& checksum) {
+  mono_wedge::topk_wedge<int, float, 4> wedge(rangeSize);
+  float top[4];
+
+  TimeGauge timer;
+  for (int time = 0; time < int(values.size()); ++time) {
+    wedge.update(time, values[time]);
+    checksum += top[wedge.top(top) - 1];
+  }
+  return timer.Stop();
+}
+
+std::chrono::nanoseconds multiset_example(const std::vector<float>& values, int rangeSize, float& checksum) {
+  std::multiset<float, std::greater<float>> range;
+
+  TimeGauge timer;
+  for (int time = 0; time < int(values.size()); ++time) {
+    if (time >= rangeSize) range.erase(range.find(values[time - rangeSize]));
+    range.insert(values[time]);
+    checksum += *std::next(range.begin(), std::min<std::ptrdiff_t>(4, range.size()) - 1);
+  }
+  return timer.Stop();
+}
+
+// Rolling maximum over the same range, with the wedge or with the general aggregator.
+std::chrono::nanoseconds wedge_max_example(const std::vector<float>& values, float& checksum) {
+  const int rangeSize = 20;
+  mono_wedge::mono_wedge<int, float> wedge(rangeSize);
+
+  TimeGauge timer;
+  for (int time = 0; time < int(values.size()); ++time) {
+    wedge.max_update(time, values[time]);
+    checksum += wedge.front_value();
+  }
+  return timer.Stop();
+}
+
+struct max_op {
+  float operator()(float a, float b) const { return a < b ? b : a; }
+};
+
+std::chrono::nanoseconds aggregate_max_example(const std::vector<float>& values, float& checksum) {
+  const int rangeSize = 20;
+  mono_wedge::window_aggregate<float, max_op> aggregate;
+
+  TimeGauge timer;
+  for (int time = 0; time < int(values.size()); ++time) {
+    if (time >= rangeSize) aggregate.pop_front();
+    aggregate.push_back(values[time]);
+    checksum += aggregate.query();
+  }
+  return timer.Stop();
+}
+
+// Reading with a heap payload, so that erasing one runs a destructor which frees memory.
+struct Reading {
+  float value;
+  std::vector<float> payload;
+};
+
+// Per-update latencies of a max wedge of readings over sawtooth ramps, whose peaks erase the whole wedge.
+std::vector<std::chrono::nanoseconds> latency_example(std::size_t work_limit) {
+  const int rangeSize = 4096, ramps = 64;
+  mono_wedge::mono_wedge<int, Reading, float> wedge(rangeSize);
+  wedge.reserve(rangeSize);
+  wedge.set_work_limit(work_limit);
+
+  std::vector<std::chrono::nanoseconds> latencies;
+  latencies.reserve(ramps * rangeSize);
+  for (int time = 0; time < ramps * rangeSize; ++time) {
+    float value = (time % (rangeSize / 2) == 0) ? 1e6f : float(-time);
+    Reading reading{value, std::vector<float>(4, value)};
+    TimeGauge timer;
+    wedge.max_update(time, std::move(reading), &Reading::value);
+    latencies.push_back(timer.Stop());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+void print_latencies(const char* name, const std::vector<std::chrono::nanoseconds>& latencies) {
+  std::cout << name << ": max " << latencies.back().count() << "ns, p99.99 "
+            << latencies[latencies.size() * 9999 / 10000].count() << "ns\n";
+}
+
 int main(void) {
   std::vector<float> values{
       72, 63, 72, 84, 29, 30, 16, 49, 83, 78, 35,  8,  5,  42, 31, 82, 72, 74, 97, 86, 5,  76, 77, 6,  6,  56, 25, 5,
@@ -128,5 +210,38 @@ int main(void) {
   const auto total = std::accumulate(times.begin(), times.end(), std::chrono::nanoseconds::zero());
   const auto avg = total / times.size();
   std::cout << "Average of " << number_of_runs << " runs with " << values.size() << " each = " << avg.count() / 1000.0 << "us\n";
+
+  float topk_checksum = 0, multiset_checksum = 0;
+  auto topk_total = std::chrono::nanoseconds::zero(), multiset_total = std::chrono::nanoseconds::zero();
+  for (int i = 0; i < number_of_runs; i++) {
+    topk_total += topk_example(values, 20, topk_checksum);
+    multiset_total += multiset_example(values, 20, multiset_checksum);
+  }
+  std::cout << "Top-4: topk_wedge " << (topk_total / number_of_runs).count() / 1000.0 << "us, std::multiset "
+            << (multiset_total / number_of_runs).count() / 1000.0 << "us"
+            << (topk_checksum == multiset_checksum ? "\n" : " (MISMATCH)\n");
+
+  // A falling ramp keeps every sample of the range, which is the worst case for the wedges.
+  std::vector<float> ramp(200000);
+  for (std::size_t i = 0; i < ramp.size(); ++i) ramp[i] = -float(i);
+  topk_checksum = multiset_checksum = 0;
+  topk_total = topk_example(ramp, 4096, topk_checksum);
+  multiset_total = multiset_example(ramp, 4096, multiset_checksum);
+  std::cout << "Top-4 on a falling ramp over 4096: topk_wedge " << topk_total.count() / 1000 << "us, std::multiset "
+            << multiset_total.count() / 1000 << "us"
+            << (topk_checksum == multiset_checksum ? "\n" : " (MISMATCH)\n");
+
+  float wedge_checksum = 0, aggregate_checksum = 0;
+  auto wedge_total = std::chrono::nanoseconds::zero(), aggregate_total = std::chrono::nanoseconds::zero();
+  for (int i = 0; i < number_of_runs; i++) {
+    wedge_total += wedge_max_example(values, wedge_checksum);
+    aggregate_total += aggregate_max_example(values, aggregate_checksum);
+  }
+  std::cout << "Max: mono_wedge " << (wedge_total / number_of_runs).count() / 1000.0 << "us, window_aggregate "
+            << (aggregate_total / number_of_runs).count() / 1000.0 << "us"
+            << (wedge_checksum == aggregate_checksum ? "\n" : " (MISMATCH)\n");
+
+  print_latencies("Update latency, immediate erasure", latency_example(0));
+  print_latencies("Update latency, work limit 4", latency_example(4));
   return 0;
 }
\ No newline at end of file
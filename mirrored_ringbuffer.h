@@ -0,0 +1,253 @@
+#ifndef MIRRORED_RINGBUFFER_H
+#define MIRRORED_RINGBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+/*
+	Ringbuffer whose storage is mapped twice, back to back, in virtual memory.
+		Its live region is therefore always contiguous:  iterators are plain
+		pointers, so searches and scans over it run as over an array, and
+		wrapping around costs nothing.
+
+		This requires memfd_create and is available on Linux only, where
+		MONO_WEDGE_MIRRORED_RINGBUFFER is defined.  The capacity is rounded up
+		so that the storage spans whole pages.
+*/
+
+#if defined(__linux__)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MONO_WEDGE_MIRRORED_RINGBUFFER 1
+
+namespace mono_wedge
+{
+	namespace detail
+	{
+		inline size_t greatest_common_divisor(size_t a, size_t b)    {while (b) {size_t r = a % b; a = b; b = r;} return a;}
+	}
+
+	template<class T>
+	class mirrored_ringbuffer
+	{
+	public:
+		typedef       T        value_type;
+		typedef       T&       reference;
+		typedef const T&       const_reference;
+		typedef       T*       pointer;
+		typedef const T*       const_pointer;
+
+		typedef size_t         size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		typedef       T*       iterator;
+		typedef const T*       const_iterator;
+
+		typedef std::reverse_iterator<iterator>                    reverse_iterator;
+		typedef std::reverse_iterator<const_iterator>              const_reverse_iterator;
+
+	public:
+		/*
+			Public interface.
+		*/
+		explicit mirrored_ringbuffer(size_type min_capacity)
+		{
+			size_t page = size_t(sysconf(_SC_PAGESIZE));
+			size_t unit = page / detail::greatest_common_divisor(page, sizeof(T));
+			_capacity = ((min_capacity > 0 ? min_capacity : 1) + unit - 1) / unit * unit;
+			_map();
+			_head = 0;
+			_size = 0;
+		}
+
+		mirrored_ringbuffer(const mirrored_ringbuffer &other) :
+			_capacity(other._capacity)
+		{
+			_map();
+			_head = 0;
+			_size = 0;
+			for (auto &t : other) push_back(t);
+		}
+
+		mirrored_ringbuffer &operator=(const mirrored_ringbuffer &other)
+		{
+			mirrored_ringbuffer copy(other);
+			swap(copy);
+			return *this;
+		}
+
+		// Moving takes the mapping, leaving the source empty with no capacity.
+		mirrored_ringbuffer(mirrored_ringbuffer &&other) noexcept :
+			_store(other._store), _capacity(other._capacity), _head(other._head), _size(other._size)
+		{
+			other._store = NULL;
+			other._capacity = other._head = other._size = 0;
+		}
+
+		mirrored_ringbuffer &operator=(mirrored_ringbuffer &&other) noexcept
+		{
+			mirrored_ringbuffer moved(std::move(other));
+			swap(moved);
+			return *this;
+		}
+
+		~mirrored_ringbuffer()
+		{
+			if (_store)
+			{
+				clear();
+				munmap(_store, 2 * _bytes());
+			}
+		}
+
+		// Accessors.
+		const_reference operator[](size_type pos) const noexcept    {return _store[_head + pos];}
+		reference       operator[](size_type pos)       noexcept    {return _store[_head + pos];}
+		const_reference at        (size_type pos) const             {if (pos >= size()) _throw_out_of_range(); return (*this)[pos];}
+		reference       at        (size_type pos)                   {if (pos >= size()) _throw_out_of_range(); return (*this)[pos];}
+		const_reference front     ()              const noexcept    {return _store[_head];}
+		reference       front     ()                    noexcept    {return _store[_head];}
+		const_reference back      ()              const noexcept    {return _store[_head + _size - 1];}
+		reference       back      ()                    noexcept    {return _store[_head + _size - 1];}
+
+		// Pointer to the contiguous live region.
+		const T *       data      ()              const noexcept    {return _store + _head;}
+		T *             data      ()                    noexcept    {return _store + _head;}
+
+		// Mutators (no insert / erase / resize!)
+		void clear()          noexcept    {_destroy_n(begin(), _size, _trivial()); _head = _size = 0;}
+		void push_front(const T &v)       {emplace_front(v);}
+		void push_front(T &&v)            {emplace_front(std::move(v));}
+		void push_back (const T &v)       {emplace_back(v);}
+		void push_back (T &&v)            {emplace_back(std::move(v));}
+		void pop_front ()     noexcept    {if (empty()) return; _store[_head].~T(); _head = _next(_head); --_size;}
+		void pop_back  ()     noexcept    {if (empty()) return; --_size; _store[_head + _size].~T();}
+
+		// Pop up to n elements at once; for trivially destructible types this only moves an index.
+		void pop_front_n(size_type n) noexcept    {n = std::min(n, _size); _destroy_n(begin(), n, _trivial()); _head = _wrap(_head + n); _size -= n;}
+		void pop_back_n (size_type n) noexcept    {n = std::min(n, _size); _size -= n; _destroy_n(end(), n, _trivial());}
+
+		template<class... Args>
+		reference emplace_front(Args&&... args)    {if (full()) throw std::bad_alloc(); new (_store + _prev(_head)) T(std::forward<Args>(args)...); _head = _prev(_head); ++_size; return front();}
+		template<class... Args>
+		reference emplace_back (Args&&... args)    {if (full()) throw std::bad_alloc(); new (_store + _head + _size) T(std::forward<Args>(args)...); ++_size; return back();}
+
+		bool try_push_back(const T &v) noexcept(std::is_nothrow_copy_constructible<T>::value)
+			{if (full()) return false; new (_store + _head + _size) T(v); ++_size; return true;}
+
+		void swap(mirrored_ringbuffer &other) noexcept
+		{
+			std::swap(_store,    other._store);
+			std::swap(_capacity, other._capacity);
+			std::swap(_head,     other._head);
+			std::swap(_size,     other._size);
+		}
+
+		// Size and capacity.
+		bool           empty   () const noexcept    {return _size == 0;}
+		bool           full    () const noexcept    {return _size == _capacity;}
+		size_type      size    () const noexcept    {return _size;}
+		size_type      max_size() const noexcept    {return _capacity;}
+		size_type      capacity() const noexcept    {return _capacity;}
+
+		// Iterators.
+		iterator       begin   ()       noexcept    {return _store + _head;}
+		iterator       end     ()       noexcept    {return _store + _head + _size;}
+		const_iterator begin   () const noexcept    {return _store + _head;}
+		const_iterator end     () const noexcept    {return _store + _head + _size;}
+		const_iterator cbegin  () const noexcept    {return _store + _head;}
+		const_iterator cend    () const noexcept    {return _store + _head + _size;}
+
+		// Reverse iterators.
+		reverse_iterator       rbegin   ()          {return reverse_iterator(end());}
+		reverse_iterator       rend     ()          {return reverse_iterator(begin());}
+		const_reverse_iterator rbegin   () const    {return const_reverse_iterator(end());}
+		const_reverse_iterator rend     () const    {return const_reverse_iterator(begin());}
+		const_reverse_iterator crbegin  () const    {return const_reverse_iterator(cend());}
+		const_reverse_iterator crend    () const    {return const_reverse_iterator(cbegin());}
+
+	private:
+		T        *_store;    // Two views of the same pages, each of _capacity elements.
+		size_type _capacity;
+		size_type _head;     // Always less than _capacity.
+		size_type _size;
+
+	private:
+		size_t    _bytes()               const    {return _capacity * sizeof(T);}
+		size_type _next(size_type pos)   const    {return (pos + 1 == _capacity) ? 0 : pos + 1;}
+		size_type _prev(size_type pos)   const    {return (pos == 0) ? _capacity - 1 : pos - 1;}
+		size_type _wrap(size_type pos)   const    {return (pos >= _capacity) ? pos - _capacity : pos;}
+
+		typedef typename std::is_trivially_destructible<T>::type _trivial;
+		static void _destroy_n(T *,       size_type,   std::true_type)     {}
+		static void _destroy_n(T *first,  size_type n, std::false_type)    {while (n--) (first++)->~T();}
+
+		void _throw_out_of_range() const    {throw std::out_of_range("mirrored_ringbuffer::at() out of range");}
+
+		// Reserve twice the storage in address space, then map one memory file into both halves.
+		void _map()
+		{
+			size_t bytes = _bytes();
+			int fd = memfd_create("mirrored_ringbuffer", MFD_CLOEXEC);
+			if (fd < 0) throw std::bad_alloc();
+
+			void *base = MAP_FAILED;
+			if (ftruncate(fd, off_t(bytes)) == 0)
+				base = mmap(NULL, 2 * bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			bool mapped = (base != MAP_FAILED)
+				&& mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+				&& mmap(static_cast<char*>(base) + bytes, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+			close(fd);
+
+			if (!mapped)
+			{
+				if (base != MAP_FAILED) munmap(base, 2 * bytes);
+				throw std::bad_alloc();
+			}
+			_store = static_cast<T*>(base);
+		}
+	};
+
+	/*
+		Storage selector for mono_wedge, placing its arrays in mirrored rings.
+	*/
+	struct mirrored_storage
+	{
+		template<class U> using ring = mirrored_ringbuffer<U>;
+	};
+}
+
+#endif // __linux__
+
+#endif // MIRRORED_RINGBUFFER_H
+
+
+/*
+	This code is available under the MIT license:
+
+		Copyright (c) 2016 Evan Balster
+
+		Permission is hereby granted, free of charge, to any person obtaining a copy of this
+		software and associated documentation files (the "Software"), to deal in the Software
+		without restriction, including without limitation the rights to use, copy, modify, merge,
+		publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+		to whom the Software is furnished to do so, subject to the following conditions:
+
+		The above copyright notice and this permission notice shall be included in all copies or
+		substantial portions of the Software.
+
+		THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+		INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+		PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+		FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+		OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+		DEALINGS IN THE SOFTWARE.
+*/
@@ -2,8 +2,27 @@
 #define MONOTONIC_WEDGE_H
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+#include "stl_ringbuffer.h"
 
 /*
         This header presents algorithms for fast running minimum and maximum using
@@ -35,11 +54,484 @@
 */
 
 namespace mono_wedge {
-template <class TTime, class T>
+namespace detail {
+/*
+        Returns the first element of [begin, end) which does not satisfy pred,
+                where pred holds for a prefix of the range.  Gallops forward from
+                begin, so the cost is logarithmic in the length of that prefix.
+*/
+template <class Iterator, class Predicate>
+Iterator gallop_partition_point(Iterator begin, Iterator end, Predicate pred) {
+  typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+
+  // All elements in [begin, lower) are known to satisfy pred.
+  Iterator lower = begin;
+  difference_type remaining = end - begin, stride = 1;
+  while (stride < remaining) {
+    Iterator probe = lower + (stride - 1);
+    if (!pred(*probe)) return std::partition_point(lower, probe, pred);
+    lower = probe + 1;
+    remaining -= stride;
+    stride <<= 1;
+  }
+  return std::partition_point(lower, end, pred);
+}
+
+/*
+        Projections map a wedge's values to the keys it compares.  They may be
+                callables or pointers to data members.
+*/
+struct identity {
+  template <class T>
+  const T& operator()(const T& value) const {
+    return value;
+  }
+};
+
+template <class Projection, class T>
+auto project(const Projection& proj, const T& value) -> decltype(proj(value)) {
+  return proj(value);
+}
+
+template <class M, class C, class T>
+const M& project(M C::*member, const T& value) {
+  return value.*member;
+}
+
+template <class Compare, class Projection>
+struct projected_compare {
+  Compare comp;
+  Projection proj;
+
+  template <class A, class B>
+  bool operator()(const A& a, const B& b) const {
+    return comp(project(proj, a), project(proj, b));
+  }
+};
+
+/*
+        Ring capacity of a new wedge.  A storage selector may set it with a
+                static initial_capacity member.
+*/
+template <class Storage, class = void>
+struct storage_initial_capacity : std::integral_constant<size_t, 16> {};
+
+template <class Storage>
+struct storage_initial_capacity<Storage, decltype(void(Storage::initial_capacity))>
+    : std::integral_constant<size_t, Storage::initial_capacity> {};
+
+/*
+        Ring of cached keys kept in parallel with a wedge's values.  With TKey =
+                void the values are their own keys, and nothing is stored.
+*/
+template <class T, class TKey, class Storage>
+class key_ring {
+ public:
+  typedef typename Storage::template ring<TKey> TKeys;
+
+  explicit key_ring(size_t capacity) : keys_(capacity) {}
+
+  TKeys& keys(typename Storage::template ring<T>&) { return keys_; }
+
+  void push_back(const TKey& key) { keys_.push_back(key); }
+  void assign(size_t pos, const TKey& key) { keys_[pos] = key; }
+  void pop_front_n(size_t n) { keys_.pop_front_n(n); }
+  void pop_back_n(size_t n) { keys_.pop_back_n(n); }
+
+  void reallocate(size_t depth) {
+    TKeys larger(depth);
+    for (auto& key : keys_) larger.push_back(std::move(key));
+    keys_.swap(larger);
+  }
+
+ private:
+  TKeys keys_;
+};
+
+template <class T, class Storage>
+class key_ring<T, void, Storage> {
+ public:
+  typedef typename Storage::template ring<T> TValues;
+
+  explicit key_ring(size_t) {}
+
+  TValues& keys(TValues& values) { return values; }
+
+  void push_back(const T&) {}
+  void assign(size_t, const T&) {}
+  void pop_front_n(size_t) {}
+  void pop_back_n(size_t) {}
+  void reallocate(size_t) {}
+};
+
+/*
+        Start of the bucket of the given width which contains time.
+                Integral times must be non-negative.
+*/
+template <class TTime>
+TTime bucket_floor(const TTime& time, const TTime& bucket, std::true_type) {
+  return std::floor(time / bucket) * bucket;
+}
+
+template <class TTime>
+TTime bucket_floor(const TTime& time, const TTime& bucket, std::false_type) {
+  return time - time % bucket;
+}
+
+template <class TTime>
+TTime bucket_floor(const TTime& time, const TTime& bucket) {
+  return bucket_floor(time, bucket, std::is_floating_point<TTime>());
+}
+
+/*
+        Start of the oldest bucket overlapping the window which ends at now.
+                The window holds times later than now - window, so with integral
+                times its oldest sample is at now - window + 1.
+*/
+template <class TTime>
+TTime window_bucket_floor(const TTime& now, const TTime& window, const TTime& bucket, std::true_type) {
+  return bucket_floor(TTime(now - window), bucket, std::true_type());
+}
+
+template <class TTime>
+TTime window_bucket_floor(const TTime& now, const TTime& window, const TTime& bucket, std::false_type) {
+  return bucket_floor(TTime(now - window + 1), bucket, std::false_type());
+}
+
+template <class TTime>
+TTime window_bucket_floor(const TTime& now, const TTime& window, const TTime& bucket) {
+  return window_bucket_floor(now, window, bucket, std::is_floating_point<TTime>());
+}
+
+/*
+        Random-access iterator over two parallel ranges, as used by the
+                structure-of-arrays wedge.  Dereferencing yields a pair of references.
+*/
+template <class TimeIterator, class ValueIterator, class Reference>
+class zip_iterator {
+ public:
+  typedef typename std::iterator_traits<ValueIterator>::difference_type difference_type;
+  typedef std::pair<typename std::iterator_traits<TimeIterator>::value_type,
+                    typename std::iterator_traits<ValueIterator>::value_type>
+      value_type;
+  typedef Reference reference;
+  typedef std::random_access_iterator_tag iterator_category;
+
+  struct pointer {
+    Reference ref;
+    const Reference* operator->() const { return &ref; }
+  };
+
+ public:
+  zip_iterator() {}
+  zip_iterator(TimeIterator time, ValueIterator value) : time_(time), value_(value) {}
+
+  reference operator*() const { return reference(*time_, *value_); }
+  pointer operator->() const { return pointer{**this}; }
+  reference operator[](difference_type offset) const { return *(*this + offset); }
+
+  bool operator==(const zip_iterator& other) const { return value_ == other.value_; }
+  bool operator!=(const zip_iterator& other) const { return value_ != other.value_; }
+  bool operator<(const zip_iterator& other) const { return value_ < other.value_; }
+  bool operator<=(const zip_iterator& other) const { return value_ <= other.value_; }
+  bool operator>(const zip_iterator& other) const { return value_ > other.value_; }
+  bool operator>=(const zip_iterator& other) const { return value_ >= other.value_; }
+
+  zip_iterator& operator++() {
+    ++time_;
+    ++value_;
+    return *this;
+  }
+  zip_iterator& operator--() {
+    --time_;
+    --value_;
+    return *this;
+  }
+  zip_iterator operator++(int) {
+    zip_iterator r = *this;
+    ++*this;
+    return r;
+  }
+  zip_iterator operator--(int) {
+    zip_iterator r = *this;
+    --*this;
+    return r;
+  }
+  zip_iterator& operator+=(difference_type offset) {
+    time_ += offset;
+    value_ += offset;
+    return *this;
+  }
+  zip_iterator& operator-=(difference_type offset) { return *this += -offset; }
+
+  zip_iterator operator+(difference_type offset) const {
+    zip_iterator r = *this;
+    r += offset;
+    return r;
+  }
+  zip_iterator operator-(difference_type offset) const {
+    zip_iterator r = *this;
+    r -= offset;
+    return r;
+  }
+  difference_type operator-(const zip_iterator& other) const { return value_ - other.value_; }
+
+ private:
+  TimeIterator time_;
+  ValueIterator value_;
+};
+}  // namespace detail
+
+/*
+        mono_wedge_search(begin, end, value, comp)
+
+        Lemire-Fenn search subroutine of the wedge update.
+
+                Behaves like std::lower_bound, returning the first element which does
+                not satisfy comp(element, value).  The range must be partitioned with
+                respect to that expression, as is the case for any monotonic wedge.
+
+                The search gallops backwards from the end of the range, doubling its
+                stride, and finishes with a binary search of the last stride.  Its cost
+                is thus logarithmic in the number of elements *behind* the result,
+                which are exactly the elements the wedge update erases.
+
+                Complexity is less than 2*log2(K) where K = distance(result, end),
+                bounded by 2*log2(N) with respect to wedge size.
+
+        Iterators must be random access.
+*/
+template <class Iterator, class T, class Compare>
+Iterator mono_wedge_search(Iterator begin, Iterator end, const T& value, Compare comp) {
+  typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+
+  // All elements in [upper, end) are known to fail comp(element, value).
+  Iterator upper = end;
+  difference_type remaining = end - begin, stride = 1;
+  while (stride < remaining) {
+    Iterator probe = upper - stride;
+    if (comp(*probe, value)) return std::lower_bound(probe + 1, upper, value, comp);
+    upper = probe;
+    remaining -= stride;
+    stride <<= 1;
+  }
+  return std::lower_bound(begin, upper, value, comp);
+}
+
+/*
+        min_wedge_search(begin, end, value)
+        max_wedge_search(begin, end, value)
+
+        Convenience variants of mono_wedge_search for min and max wedges.
+                These will use std::less/greater, which default to operator </>.
+*/
+template <class Iterator, class T>
+Iterator min_wedge_search(Iterator begin, Iterator end, const T& value) {
+  return mono_wedge_search(begin, end, value, std::less<T>());
+}
+
+template <class Iterator, class T>
+Iterator max_wedge_search(Iterator begin, Iterator end, const T& value) {
+  return mono_wedge_search(begin, end, value, std::greater<T>());
+}
+
+/*
+        mono_wedge_update(wedge, value, comp)
+
+        Update a monotonic wedge with a new value.
+
+                Erases values which do not satisfy comp(element, value), then
+                appends value to the wedge via push_back.
+
+                Complexity is less than log2(N) with respect to wedge size.
+                Complexity of N calls is O(N), if wedge is initially empty.
+                Thus, amortized complexity over many calls is constant.
+
+        Wedge type must:
+                - Produce random access iterators via begin/end.
+                - Support push_back and pop_back.
+
+        A "less" comparator yields a min-wedge.
+        A "greater" comparator yields a max-wedge.
+*/
+template <class Wedge, class T, class Compare>
+void mono_wedge_update(Wedge& wedge, T&& value, Compare comp) {
+  auto i = mono_wedge_search(wedge.begin(), wedge.end(), value, comp);
+  size_t erase_count = size_t(wedge.end() - i);
+  while (erase_count--) wedge.pop_back();
+  wedge.push_back(std::forward<T>(value));
+}
+
+/*
+        min_wedge_update(wedge, value)
+        max_wedge_update(wedge, value)
+
+        Convenience variants of mono_wedge_update for min and max wedges.
+                These will use std::less/greater, which default to operator </>.
+*/
+template <class Wedge, class T>
+void min_wedge_update(Wedge& wedge, T&& value) {
+  mono_wedge_update(wedge, std::forward<T>(value), std::less<typename Wedge::value_type>());
+}
+
+template <class Wedge, class T>
+void max_wedge_update(Wedge& wedge, T&& value) {
+  mono_wedge_update(wedge, std::forward<T>(value), std::greater<typename Wedge::value_type>());
+}
+
+/*
+        mono_wedge_update(wedge, value, comp, proj)
+        min_wedge_update(wedge, value, proj)
+        max_wedge_update(wedge, value, proj)
+
+        Variants comparing the keys proj(element) and proj(value), where proj is
+                a callable or a pointer to a data member.  The keys are projected on
+                every comparison; the mono_wedge class can cache them instead.
+*/
+template <class Wedge, class T, class Compare, class Projection>
+void mono_wedge_update(Wedge& wedge, T&& value, Compare comp, Projection proj) {
+  mono_wedge_update(wedge, std::forward<T>(value), detail::projected_compare<Compare, Projection>{comp, proj});
+}
+
+template <class Wedge, class T, class Projection>
+void min_wedge_update(Wedge& wedge, T&& value, Projection proj) {
+  mono_wedge_update(wedge, std::forward<T>(value), std::less<>(), proj);
+}
+
+template <class Wedge, class T, class Projection>
+void max_wedge_update(Wedge& wedge, T&& value, Projection proj) {
+  mono_wedge_update(wedge, std::forward<T>(value), std::greater<>(), proj);
+}
+
+/*
+        Storage selectors for mono_wedge.  ring_storage places its arrays in
+                fixed_ringbuffers, which the wedge grows by doubling;  growable_storage
+                uses growable_ringbuffers, which also shrink as the wedge empties, so
+                that long-lived wedges hold memory for their current depth only.
+                inline_storage<N> keeps up to N samples inside the wedge object and
+                spills to the heap only for deeper wedges, which suits the shallow
+                wedges of noisy signals.  Each ring holds its own inline block and
+                indices besides the wedge's real-time state, so mono_wedge<unsigned,
+                float, void, inline_storage<8>> takes 168 bytes on 64-bit targets;
+                small_wedge keeps the same eight samples in 104.  See
+                mirrored_ringbuffer.h for another alternative.
+*/
+struct ring_storage {
+  template <class U>
+  using ring = fixed_ringbuffer<U>;
+};
+
+struct growable_storage {
+  template <class U>
+  using ring = growable_ringbuffer<U, std::allocator<U>, true>;
+};
+
+template <size_t N>
+struct inline_storage {
+  static const size_t initial_capacity = N;
+  template <class U>
+  using ring = small_ringbuffer<U, N>;
+};
+
+template <class TTime, class T, class TKey = void, class Storage = ring_storage>
 class mono_wedge {
  public:
-  typedef std::map<TTime, T> TCollection;
-  typedef typename TCollection::iterator iterator;
+  typedef std::pair<TTime, T> value_type;
+  typedef typename std::conditional<std::is_void<TKey>::value, T, TKey>::type key_type;
+  typedef typename Storage::template ring<TTime> TTimes;
+  typedef typename Storage::template ring<T> TValues;
+  typedef typename TValues::size_type size_type;
+  typedef typename TValues::difference_type difference_type;
+
+  typedef detail::zip_iterator<typename TTimes::const_iterator, typename TValues::iterator,
+                               std::pair<const TTime&, T&> >
+      iterator;
+  typedef detail::zip_iterator<typename TTimes::const_iterator, typename TValues::const_iterator,
+                               std::pair<const TTime&, const T&> >
+      const_iterator;
+
+  /*
+          The wedge is stored as a structure of arrays:  times and values live in
+                  two parallel ring-buffers, so the value search and the time search
+                  each scan one dense array.  The rings double their capacity whenever
+                  they run full.  Once the wedge has reached its working depth, updates
+                  and pops do not touch the heap.
+
+          Iterators yield (time, value) pairs of references.
+
+          With a TKey, the wedge compares keys projected from the values, and
+                  caches them in a third ring so the search scans only the keys.
+                  Otherwise the values are compared directly.
+  */
+  mono_wedge()
+      : times_(initial_capacity),
+        values_(initial_capacity),
+        keys_(initial_capacity),
+        window_(),
+        windowed_(false),
+        work_limit_(0),
+        dead_front_(0),
+        dead_back_(0) {}
+
+  /*
+          A windowed wedge expires samples automatically on update, keeping only
+                  those whose time is within window of the latest sample's time.
+  */
+  explicit mono_wedge(const TTime& window)
+      : times_(initial_capacity),
+        values_(initial_capacity),
+        keys_(initial_capacity),
+        window_(window),
+        windowed_(true),
+        work_limit_(0),
+        dead_front_(0),
+        dead_back_(0) {}
+
+  /*
+          Real-time mode:  with a nonzero work limit, erased and expired samples
+                  are only marked dead, and each call destroys at most limit of them.
+                  Dead samples at the back are overwritten by later updates.  Results
+                  are unaffected, and update, pop_front and expiry then cost O(log N)
+                  in the worst case, provided reserve was called with the wedge's
+                  largest depth so that the rings never grow.
+
+                  With a limit of zero (the default), samples are destroyed at once.
+                  Batch updates are not bounded and destroy every dead sample first.
+  */
+  void set_work_limit(size_type limit) { work_limit_ = limit; }
+  size_type work_limit() const { return work_limit_; }
+
+  /*
+          Member counterpart of mono_wedge_update, growing the rings when full.
+                  A "less" comparator yields a min-wedge, a "greater" one a max-wedge;
+                  a wedge must always be updated with the same comparator.  Rvalue
+                  values are moved into the wedge, and moved again only on growth.
+  */
+  template <class Compare>
+  void update(const TTime& time, const T& value, Compare comp) {
+    insert(time, value, comp, detail::identity());
+  }
+
+  template <class Compare>
+  void update(const TTime& time, T&& value, Compare comp) {
+    insert(time, std::move(value), comp, detail::identity());
+  }
+
+  /*
+          Update with a projection, which maps a value to the key to compare.
+                  It may be a callable or a pointer to a data member, and must be the
+                  same for every update of the wedge.  The key is computed once and
+                  cached, which requires a wedge with a TKey.
+  */
+  template <class Compare, class Projection>
+  void update(const TTime& time, const T& value, Compare comp, const Projection& proj) {
+    insert(time, value, comp, proj);
+  }
+
+  template <class Compare, class Projection>
+  void update(const TTime& time, T&& value, Compare comp, const Projection& proj) {
+    insert(time, std::move(value), comp, proj);
+  }
 
   /*
           min_wedge_update(wedge, value)
@@ -48,73 +540,1009 @@ class mono_wedge {
           Convenience variants of mono_wedge_update for min and max wedges.
                   These will use std::greater/less, which default to operator >/<.
   */
-  void min_update(const TTime& time, const T& value) { return update(time, value, std::less<T>()); }
+  void min_update(const TTime& time, const T& value) { return update(time, value, std::less<key_type>()); }
+  void min_update(const TTime& time, T&& value) { return update(time, std::move(value), std::less<key_type>()); }
 
-  void max_update(const TTime& time, const T& value) { return update(time, value, std::greater<T>()); }
-  iterator begin() { return wedge_.begin(); }
-  iterator end() { return wedge_.end(); }
+  void max_update(const TTime& time, const T& value) { return update(time, value, std::greater<key_type>()); }
+  void max_update(const TTime& time, T&& value) { return update(time, std::move(value), std::greater<key_type>()); }
 
-  void pop_front() { wedge_.erase(wedge_.begin()); };
+  template <class Projection>
+  void min_update(const TTime& time, const T& value, const Projection& proj) {
+    return update(time, value, std::less<key_type>(), proj);
+  }
 
- private:
-  TCollection wedge_;
+  template <class Projection>
+  void min_update(const TTime& time, T&& value, const Projection& proj) {
+    return update(time, std::move(value), std::less<key_type>(), proj);
+  }
+
+  template <class Projection>
+  void max_update(const TTime& time, const T& value, const Projection& proj) {
+    return update(time, value, std::greater<key_type>(), proj);
+  }
+
+  template <class Projection>
+  void max_update(const TTime& time, T&& value, const Projection& proj) {
+    return update(time, std::move(value), std::greater<key_type>(), proj);
+  }
+
+  /*
+          min_update_batch(times, values, n, out)
+          max_update_batch(times, values, n, out)
+
+          Update the wedge with n samples at once, with the same result as n
+                  calls to min_update or max_update.
+
+                  Samples dominated by a later sample of the same batch are skipped,
+                  so only the batch's surviving suffix extrema touch the wedge.
+
+                  If out is given, the rolling minimum or maximum after each sample
+                  is written to out[0..n) instead; every sample is then applied.
+
+                  Batches compare the values themselves, so they are not available on
+                  wedges with a TKey.
+  */
+  void min_update_batch(const TTime* times, const T* values, size_type n, T* out = nullptr) {
+    update_batch(times, values, n, std::less<T>(), out);
+  }
+
+  void max_update_batch(const TTime* times, const T* values, size_type n, T* out = nullptr) {
+    update_batch(times, values, n, std::greater<T>(), out);
+  }
+
+#if defined(__cpp_lib_span)
+  void min_update_batch(std::span<const TTime> times, std::span<const T> values, std::span<T> out = {}) {
+    update_batch(times.data(), values.data(), values.size(), std::less<T>(), out.empty() ? nullptr : out.data());
+  }
+
+  void max_update_batch(std::span<const TTime> times, std::span<const T> values, std::span<T> out = {}) {
+    update_batch(times.data(), values.data(), values.size(), std::greater<T>(), out.empty() ? nullptr : out.data());
+  }
+#endif
+
+  iterator begin() { return iterator(times_.cbegin() + live_begin(), values_.begin() + live_begin()); }
+  iterator end() { return iterator(times_.cend() - live_end(), values_.end() - live_end()); }
+  const_iterator begin() const { return const_iterator(times_.cbegin() + live_begin(), values_.cbegin() + live_begin()); }
+  const_iterator end() const { return const_iterator(times_.cend() - live_end(), values_.cend() - live_end()); }
 
   /*
-          mono_wedge_update(wedge, value, comp)
+          The extremum is at the front of the wedge and the latest sample at the
+                  back.  These return references into the wedge, which must not be
+                  empty; front_time() is the time at which the extremum occurred.
+  */
+  const TTime& front_time() const { return times_[dead_front_]; }
+  const T& front_value() const { return values_[dead_front_]; }
+  const TTime& back_time() const { return times_[values_.size() - 1 - dead_back_]; }
+  const T& back_value() const { return values_[values_.size() - 1 - dead_back_]; }
 
-          Update a monotonic wedge with a new value.
+  bool empty() const { return size() == 0; }
+  size_type size() const { return values_.size() - dead_front_ - dead_back_; }
+  size_type capacity() const { return values_.capacity(); }
 
-                  Erases values which do not satisfy comp(element, value), then
-                  appends value to the wedge via push_back.
+  // Pre-allocate storage for a wedge of at least the given depth.
+  void reserve(size_type depth) {
+    if (depth > capacity()) reallocate(depth);
+  }
 
-                  Complexity is less than log2(N) with respect to wedge size.
-                  Complexity of N calls is O(N), if wedge is initially empty.
-                  Thus, amortized complexity over many calls is constant.
+  // Like the rings, popping an empty wedge does nothing.
+  void pop_front() {
+    if (empty()) return;
+    ++dead_front_;
+    collect();
+  };
 
-          Wedge type must:
-                  - Produce random access iterators via begin/end.
-                  - Support push_back.
+  /*
+          expire_before(cutoff)
+          expire_window(now, window)
+
+          Pop all samples whose time is less than cutoff, or whose age relative
+                  to now is window or more.  Returns the number of popped samples.
 
-          A "less" comparator yields a min-wedge_.
-          A "greater" comparator yields a max-wedge_.
+                  Times in the wedge are monotonic, so the stale prefix is located by
+                  galloping search before it is popped.
   */
+  size_type expire_before(const TTime& cutoff) {
+    size_type count = expire_prefix([&cutoff](const TTime& time) { return time < cutoff; });
+    collect();
+    return count;
+  }
+
+  size_type expire_window(const TTime& now, const TTime& window) {
+    size_type count = mark_expired(now, window);
+    collect();
+    return count;
+  }
+
+  /*
+          since(time)
+          query_since(time)
+          query(window)
+
+          Answer for a shorter horizon than the wedge was expired with.
+
+                  Because the wedge is monotonic, the extremum of all samples since a
+                  given time is the first element of the wedge at or after that time.
+                  It is located by binary search over the times, so several horizons
+                  can be served by one wedge kept for the longest of them.
+
+                  since() returns an iterator to that element, or end() if there is
+                  none.  query_since() and query() return its value; query() takes a
+                  window relative to the latest sample, like expire_window.  These
+                  require a non-empty wedge, and a time no later than the latest one.
+  */
+  const_iterator since(const TTime& time) const {
+    auto first = times_.begin() + live_begin();
+    auto i = std::lower_bound(first, times_.end() - live_end(), time);
+    return begin() + (i - first);
+  }
+
+  const T& query_since(const TTime& time) const { return since(time)->second; }
+
+  const T& query(const TTime& window) const {
+    const TTime& now = back_time();
+    auto first = times_.begin() + live_begin();
+    auto i = std::partition_point(first, times_.end() - live_end(),
+                                  [&now, &window](const TTime& time) { return !(now - time < window); });
+    return (begin() + (i - first))->second;
+  }
+
+ private:
+  static const size_type initial_capacity = detail::storage_initial_capacity<Storage>::value;
+
+  TTimes times_;
+  TValues values_;
+  detail::key_ring<T, TKey, Storage> keys_;
+  TTime window_;
+  bool windowed_;
+
+  // Dead samples are erased but not yet destroyed; they lie outside the live range of the rings.
+  size_type work_limit_, dead_front_, dead_back_;
+
+  difference_type live_begin() const { return difference_type(dead_front_); }
+  difference_type live_end() const { return difference_type(dead_back_); }
+
+  template <class Predicate>
+  size_type expire_prefix(Predicate stale) {
+    auto first = times_.begin() + live_begin();
+    size_type count = size_type(detail::gallop_partition_point(first, times_.end() - live_end(), stale) - first);
+    dead_front_ += count;
+    return count;
+  }
+
+  size_type mark_expired(const TTime& now, const TTime& window) {
+    return expire_prefix([&now, &window](const TTime& time) { return !(now - time < window); });
+  }
+
+  // Mark all samples at the end whose keys do not satisfy comp(element, key) dead.
   template <class Compare>
-  void update(const TTime& time, const T& value, Compare comp) {
-    auto new_sample = std::make_pair(time, value);
-    // erase all pairs at end whose value is less or equal to value
-    if (!wedge_.empty()) {
-      auto map_comp = [&comp](const typename TCollection::value_type& val1,
-                              const typename TCollection::value_type& val2) { return comp(val1.second, val2.second); };
-      
-      // get iterator to first element (from left to right) that is greater or equal to value
-      auto i = std::lower_bound(wedge_.begin(), wedge_.end(), new_sample, map_comp);
-      wedge_.erase(i, wedge_.end());
+  void erase_dominated(const key_type& key, Compare comp) {
+    auto& keys = keys_.keys(values_);
+    auto last = keys.end() - live_end();
+    dead_back_ += size_type(last - mono_wedge_search(keys.begin() + live_begin(), last, key, comp));
+  }
+
+  // The value is copied or moved into the wedge once; with TKey = void its key refers to it.
+  template <class V, class Compare, class Projection>
+  void insert(const TTime& time, V&& value, Compare comp, const Projection& proj) {
+    static_assert(!std::is_void<TKey>::value || std::is_same<Projection, detail::identity>::value,
+                  "a projection requires a mono_wedge with a key type");
+    if (windowed_) mark_expired(time, window_);
+
+    const key_type& key = detail::project(proj, value);
+    erase_dominated(key, comp);
+    push_back(time, std::forward<V>(value), key);
+    collect();
+  }
+
+  // Append a sample, reusing the first dead slot at the back if there is one.
+  // The key is stored before the value, which it may refer to, is moved.
+  template <class V>
+  void push_back(const TTime& time, V&& value, const key_type& key) {
+    if (dead_back_) {
+      size_type pos = values_.size() - dead_back_--;
+      keys_.assign(pos, key);
+      times_[pos] = time;
+      values_[pos] = std::forward<V>(value);
+      return;
+    }
+    if (values_.full()) {
+      if (dead_front_) {
+        --dead_front_;
+        pop_physical_front(1);
+      } else {
+        reallocate(2 * capacity());
+      }
     }
-    wedge_.insert(new_sample);
+    keys_.push_back(key);
+    times_.push_back(time);
+    values_.push_back(std::forward<V>(value));
+  }
+
+  void pop_physical_front(size_type n) {
+    times_.pop_front_n(n);
+    values_.pop_front_n(n);
+    keys_.pop_front_n(n);
   }
 
+  void pop_physical_back(size_type n) {
+    times_.pop_back_n(n);
+    values_.pop_back_n(n);
+    keys_.pop_back_n(n);
+  }
+
+  // Destroy up to work_limit_ dead samples, or all of them without a limit.
+  void collect() { collect(work_limit_ ? work_limit_ : values_.size()); }
+
+  void collect(size_type budget) {
+    size_type n = std::min(budget, dead_front_);
+    pop_physical_front(n);
+    dead_front_ -= n;
+    n = std::min(budget - n, dead_back_);
+    pop_physical_back(n);
+    dead_back_ -= n;
+  }
+
+  void reallocate(size_type depth) {
+    collect(values_.size());
+    TTimes larger_times(depth);
+    TValues larger_values(depth);
+    for (auto& time : times_) larger_times.push_back(std::move(time));
+    for (auto& value : values_) larger_values.push_back(std::move(value));
+    times_.swap(larger_times);
+    values_.swap(larger_values);
+    keys_.reallocate(depth);
+  }
+
+  template <class Compare>
+  void update_batch(const TTime* times, const T* values, size_type n, Compare comp, T* out) {
+    static_assert(std::is_void<TKey>::value, "batch updates compare values, and cannot project keys");
+    if (out) {
+      for (size_type i = 0; i < n; ++i) {
+        update(times[i], values[i], comp);
+        out[i] = front_value();
+      }
+      return;
+    }
+    if (n == 0) return;
+    collect(values_.size());
+
+    // Expire the wedge and skip the batch's stale prefix first, so that storage grows with the window, not the batch.
+    size_type first = 0;
+    if (windowed_) {
+      const TTime& now = times[n - 1];
+      expire_window(now, window_);
+      while (!(now - times[first] < window_)) ++first;
+    }
+
+    // A sample survives the batch if it satisfies comp against every later sample.
+    // The earliest survivor is the batch's extremum.
+    size_type best = n - 1, survivors = 1;
+    for (size_type i = n - 1; i-- > first;) {
+      if (comp(values[i], values[best])) {
+        best = i;
+        ++survivors;
+      }
+    }
+
+    erase_dominated(values[best], comp);
+    collect(values_.size());
+    if (size() + survivors > capacity()) reallocate(std::max(size() + survivors, 2 * capacity()));
+
+    // Append the survivors latest-first, then restore their chronological order.
+    size_type last = n - 1;
+    push_back(times[last], values[last], values[last]);
+    for (size_type i = n - 1; i-- > best;) {
+      if (comp(values[i], values[last])) {
+        last = i;
+        push_back(times[last], values[last], values[last]);
+      }
+    }
+    std::reverse(times_.end() - difference_type(survivors), times_.end());
+    std::reverse(values_.end() - difference_type(survivors), values_.end());
+  }
+};
+
+/*
+        Policies for a fixed_wedge whose storage is full when a sample arrives
+                which dominates nothing.  These are chosen at compile time.
+*/
+namespace overflow {
+// Fail an assertion; without assertions, behave as drop_oldest.
+struct assert_full {
+  static bool admit() noexcept {
+    assert(!"fixed_wedge overflow");
+    return true;
+  }
+};
+
+// Pop the oldest sample to make room for the new one.
+struct drop_oldest {
+  static bool admit() noexcept { return true; }
+};
+
+// Reject the new sample and report it by returning false from update.
+struct report {
+  static bool admit() noexcept { return false; }
+};
+}  // namespace overflow
+
+/*
+        fixed_wedge<TTime, T, Overflow, N>
+        static_wedge<TTime, T, N, Overflow>
+
+        Real-time profile of mono_wedge with all storage reserved on construction.
+
+                The rings are sized from the window:  with strictly increasing integral
+                times, a wedge expired by a window of W can never hold more than W
+                samples.  Repeated times void that bound, and other times need an
+                explicit capacity.  After construction no operation allocates or throws,
+                provided the comparator does not throw.
+
+                Should the wedge be full nonetheless, the Overflow policy decides the
+                outcome at compile time; see the overflow namespace.
+
+                With a nonzero N, the rings are static_ringbuffers holding N samples
+                inline, and the whole wedge is one allocation-free object.
+*/
+template <class TTime, class T, class Overflow = overflow::assert_full, size_t N = 0>
+class fixed_wedge {
+  static_assert(std::is_nothrow_copy_constructible<TTime>::value && std::is_nothrow_copy_constructible<T>::value,
+                "fixed_wedge requires times and values with non-throwing copies");
+
+ public:
+  typedef typename std::conditional<N == 0, fixed_ringbuffer<TTime>, static_ringbuffer<TTime, N> >::type TTimes;
+  typedef typename std::conditional<N == 0, fixed_ringbuffer<T>, static_ringbuffer<T, N> >::type TValues;
+  typedef typename TValues::size_type size_type;
+
+  typedef detail::zip_iterator<typename TTimes::const_iterator, typename TValues::const_iterator,
+                               std::pair<const TTime&, const T&> >
+      const_iterator;
+
+  explicit fixed_wedge(const TTime& window) : fixed_wedge(window, N ? N : size_type(window)) {
+    static_assert(N != 0 || std::is_integral<TTime>::value,
+                  "sizing a fixed_wedge from its window requires integral times; pass a capacity");
+  }
+
+  fixed_wedge(const TTime& window, size_type capacity) : times_(capacity), values_(capacity), window_(window) {}
+
   /*
-          C++11 variants of mono_wedge_update supporting rvalue references.
+          Expire samples outside the window of time, then add the sample as
+                  mono_wedge::update does.  Returns false if the sample was rejected by
+                  the overflow policy.
   */
   template <class Compare>
-  void update(T&& value, Compare comp) {
-    auto i = mono_wedge_search(wedge_.begin(), wedge_.end(), value, comp);
-    size_t erase_count = std::distance(i, wedge_.end());
-    while (erase_count--) wedge_.pop_back();
-    wedge_.push_back(std::forward(value));
+  bool update(const TTime& time, const T& value, Compare comp) noexcept {
+    expire_window(time, window_);
+
+    auto i = mono_wedge_search(values_.begin(), values_.end(), value, comp);
+    size_type erase_count = size_type(values_.end() - i);
+    if (erase_count == 0 && values_.full()) {
+      if (!Overflow::admit()) return false;
+      pop_front();
+    }
+    times_.pop_back_n(erase_count);
+    values_.pop_back_n(erase_count);
+    times_.try_push_back(time);
+    values_.try_push_back(value);
+    return true;
   }
 
+  bool min_update(const TTime& time, const T& value) noexcept { return update(time, value, std::less<T>()); }
+  bool max_update(const TTime& time, const T& value) noexcept { return update(time, value, std::greater<T>()); }
+
+  const_iterator begin() const noexcept { return const_iterator(times_.cbegin(), values_.cbegin()); }
+  const_iterator end() const noexcept { return const_iterator(times_.cend(), values_.cend()); }
+
+  // The extremum and the latest sample.  The wedge must not be empty.
+  const TTime& front_time() const noexcept { return times_.front(); }
+  const T& front_value() const noexcept { return values_.front(); }
+  const TTime& back_time() const noexcept { return times_.back(); }
+  const T& back_value() const noexcept { return values_.back(); }
+
+  bool empty() const noexcept { return values_.empty(); }
+  bool full() const noexcept { return values_.full(); }
+  size_type size() const noexcept { return values_.size(); }
+  size_type capacity() const noexcept { return values_.capacity(); }
+
+  void pop_front() noexcept {
+    times_.pop_front();
+    values_.pop_front();
+  }
+
+  // Pop samples whose time is less than cutoff, or whose age relative to now is window or more.
+  size_type expire_before(const TTime& cutoff) noexcept {
+    return expire_prefix([&cutoff](const TTime& time) { return time < cutoff; });
+  }
+
+  size_type expire_window(const TTime& now, const TTime& window) noexcept {
+    return expire_prefix([&now, &window](const TTime& time) { return !(now - time < window); });
+  }
+
+ private:
+  TTimes times_;
+  TValues values_;
+  TTime window_;
+
+  template <class Predicate>
+  size_type expire_prefix(Predicate stale) noexcept {
+    size_type count = size_type(detail::gallop_partition_point(times_.begin(), times_.end(), stale) - times_.begin());
+    times_.pop_front_n(count);
+    values_.pop_front_n(count);
+    return count;
+  }
+};
+
+template <class TTime, class T, size_t N, class Overflow = overflow::assert_full>
+using static_wedge = fixed_wedge<TTime, T, Overflow, N>;
+
+/*
+        small_wedge<TTime, T, N>
+
+        Compact wedge for keeping many shallow wedges, such as one per key.
+
+                Samples are (time, value) pairs in a single small_ringbuffer, so times
+                and values share one set of ring indices, and up to N samples live
+                inside the object.  Deeper wedges spill to the heap and double from
+                there, as with inline_storage.  There is no real-time mode, key
+                projection or batch update;  mono_wedge provides those.
+
+                small_wedge<unsigned, float, 8> takes 104 bytes on 64-bit targets,
+                against 168 for mono_wedge with inline_storage<8>.
+*/
+template <class TTime, class T, size_t N = 8>
+class small_wedge {
+ public:
+  typedef std::pair<TTime, T> value_type;
+  typedef small_ringbuffer<value_type, N> TSamples;
+  typedef typename TSamples::size_type size_type;
+  typedef typename TSamples::const_iterator const_iterator;
+
+  small_wedge() : window_(), windowed_(false) {}
+
+  // A windowed wedge expires samples automatically on update, as mono_wedge does.
+  explicit small_wedge(const TTime& window) : window_(window), windowed_(true) {}
+
+  // Add a sample, erasing those which do not satisfy comp(value, sample value).
   template <class Compare>
-  void min_update(TCollection& wedge, T&& value) {
-    update(wedge, std::forward(value), std::less<T>());
+  void update(const TTime& time, const T& value, Compare comp) {
+    if (windowed_) expire_window(time, window_);
+    auto i = mono_wedge_search(samples_.begin(), samples_.end(), value,
+                               [&comp](const value_type& sample, const T& v) { return comp(sample.second, v); });
+    samples_.pop_back_n(size_type(samples_.end() - i));
+    samples_.emplace_back(time, value);
+  }
+
+  void min_update(const TTime& time, const T& value) { update(time, value, std::less<T>()); }
+  void max_update(const TTime& time, const T& value) { update(time, value, std::greater<T>()); }
+
+  const_iterator begin() const { return samples_.begin(); }
+  const_iterator end() const { return samples_.end(); }
+
+  // The extremum and the latest sample.  The wedge must not be empty.
+  const TTime& front_time() const { return samples_.front().first; }
+  const T& front_value() const { return samples_.front().second; }
+  const TTime& back_time() const { return samples_.back().first; }
+  const T& back_value() const { return samples_.back().second; }
+
+  bool empty() const { return samples_.empty(); }
+  size_type size() const { return samples_.size(); }
+  size_type capacity() const { return samples_.capacity(); }
+
+  void reserve(size_type depth) { samples_.reserve(depth); }
+
+  void pop_front() { samples_.pop_front(); }
+
+  // Pop samples whose time is less than cutoff, or whose age relative to now is window or more.
+  size_type expire_before(const TTime& cutoff) {
+    return expire_prefix([&cutoff](const TTime& time) { return time < cutoff; });
+  }
+
+  size_type expire_window(const TTime& now, const TTime& window) {
+    return expire_prefix([&now, &window](const TTime& time) { return !(now - time < window); });
+  }
+
+ private:
+  TSamples samples_;
+  TTime window_;
+  bool windowed_;
+
+  template <class Predicate>
+  size_type expire_prefix(Predicate stale) {
+    auto stale_sample = [&stale](const value_type& sample) { return stale(sample.first); };
+    if (samples_.empty() || !stale_sample(samples_.front())) return 0;
+    size_type count = size_type(detail::gallop_partition_point(samples_.begin(), samples_.end(), stale_sample) -
+                                samples_.begin());
+    samples_.pop_front_n(count);
+    return count;
+  }
+};
+
+/*
+        minmax_wedge<TTime, T>
+
+        Rolling minimum and maximum of a single stream of (time, value) samples.
+
+                This is a pair of mono_wedges fed by one update call and expired
+                together, not a fused structure:  each stores its own times and runs
+                its own search, so an update costs about as much as two wedges.  Only
+                the expiry check is shared;  the oldest time held by either wedge is
+                cached, so expiry costs a single comparison when there is nothing to
+                evict.  Like mono_wedge, it may be constructed with a window to expire
+                samples automatically on update.
+
+                range() yields the rolling peak-to-peak value max() - min().
+*/
+template <class TTime, class T>
+class minmax_wedge {
+ public:
+  typedef typename mono_wedge<TTime, T>::size_type size_type;
+
+  minmax_wedge() : oldest_(), window_(), windowed_(false) {}
+  explicit minmax_wedge(const TTime& window) : oldest_(), window_(window), windowed_(true) {}
+
+  void update(const TTime& time, const T& value) {
+    if (empty()) {
+      oldest_ = time;
+    } else if (windowed_ && !(time - oldest_ < window_)) {
+      min_wedge_.expire_window(time, window_);
+      max_wedge_.expire_window(time, window_);
+      update_oldest();
+    }
+    min_wedge_.min_update(time, value);
+    max_wedge_.max_update(time, value);
+  }
+
+  // Pop all samples whose time is less than cutoff.
+  void expire_before(const TTime& cutoff) {
+    if (empty() || !(oldest_ < cutoff)) return;
+    min_wedge_.expire_before(cutoff);
+    max_wedge_.expire_before(cutoff);
+    update_oldest();
+  }
+
+  // Minimum, maximum and peak-to-peak range of the wedge, which must not be empty.
+  const T& min() const { return min_wedge_.front_value(); }
+  const T& max() const { return max_wedge_.front_value(); }
+  T range() const { return max() - min(); }
+
+  // Times at which the minimum and maximum occurred.
+  const TTime& min_time() const { return min_wedge_.front_time(); }
+  const TTime& max_time() const { return max_wedge_.front_time(); }
+
+  // Both wedges hold the latest sample, so they are empty together.
+  bool empty() const { return max_wedge_.empty(); }
+
+  void reserve(size_type depth) {
+    min_wedge_.reserve(depth);
+    max_wedge_.reserve(depth);
+  }
+
+  const mono_wedge<TTime, T>& min_wedge() const { return min_wedge_; }
+  const mono_wedge<TTime, T>& max_wedge() const { return max_wedge_; }
+
+ private:
+  mono_wedge<TTime, T> min_wedge_, max_wedge_;
+  TTime oldest_, window_;
+  bool windowed_;
+
+  void update_oldest() {
+    if (!empty()) oldest_ = std::min(min_time(), max_time());
+  }
+};
+
+/*
+        sample_wedge<T, TIndex>
+
+        Wedge for uniformly sampled streams, where a sample's time is its index.
+
+                The wedge counts the samples it is given and stores only a compact
+                TIndex beside each value; the window is a number of samples.  As each
+                update advances time by one sample, at most one sample can leave the
+                window, so expiry is a single integer comparison against the front.
+
+                The counter may wrap around; indices are compared modulo 2^bits.
+*/
+template <class T, class TIndex = std::uint32_t>
+class sample_wedge {
+ public:
+  typedef mono_wedge<TIndex, T> TWedge;
+  typedef typename TWedge::size_type size_type;
+  typedef typename TWedge::const_iterator const_iterator;
+
+  explicit sample_wedge(TIndex window) : window_(window), count_(0) {}
+
+  void min_update(const T& value) {
+    expire();
+    wedge_.min_update(count_++, value);
+  }
+
+  void max_update(const T& value) {
+    expire();
+    wedge_.max_update(count_++, value);
+  }
+
+  // The minimum or maximum of the last window samples.  The wedge must not be empty.
+  const T& front() const { return wedge_.front_value(); }
+
+  // Index of the sample holding the extremum, and the number of samples since it.
+  TIndex arg_extremum() const { return wedge_.front_time(); }
+  TIndex age() const { return TIndex(count_ - 1 - wedge_.front_time()); }
+
+  // Iterate (index, value) pairs.
+  const_iterator begin() const { return wedge_.begin(); }
+  const_iterator end() const { return wedge_.end(); }
+
+  bool empty() const { return wedge_.empty(); }
+  size_type size() const { return wedge_.size(); }
+  void reserve(size_type depth) { wedge_.reserve(depth); }
+
+  // Index of the next sample.
+  TIndex count() const { return count_; }
+  TIndex window() const { return window_; }
+
+ private:
+  TWedge wedge_;
+  TIndex window_, count_;
+
+  void expire() {
+    if (!wedge_.empty() && !(TIndex(count_ - wedge_.front_time()) < window_)) wedge_.pop_front();
   }
+};
+
+/*
+        cascade_wedge<TTime, T, Compare>
+
+        Rolling extremum over very long horizons with bounded memory.
+
+                A fine mono_wedge holds raw samples over a short horizon.  Each coarser
+                level splits time into buckets of a fixed width (EG. seconds, minutes,
+                hours), tracks the extremum of the open bucket, and feeds closed
+                buckets into its own wedge, which spans that level's horizon.  Each
+                level thus holds at most about horizon/bucket entries, and an update
+                costs O(1) amortized per level.
+
+                query(window) answers from the fine wedge when window is within its
+                horizon; the answer is then exact.  Otherwise it answers from the
+                first level whose horizon covers window (or the coarsest level), using
+                every bucket that overlaps the window.  The answer is then the extremum
+                over a superset of the window reaching at most one bucket width further
+                back; it is exact whenever the oldest overlapping bucket lies entirely
+                inside the window.
+
+                window must not exceed the horizon of the coarsest level, or of the
+                fine wedge when there are no levels.  Older samples have already been
+                discarded, so a longer window could only be answered over a subset of
+                it;  debug builds assert instead.
+
+                Compare selects the extremum as for mono_wedge_update; the default
+                std::greater tracks the maximum.  Levels must be added in order of
+                increasing bucket width and horizon.  Integral times must be
+                non-negative.
+*/
+template <class TTime, class T, class Compare = std::greater<T> >
+class cascade_wedge {
+ public:
+  explicit cascade_wedge(const TTime& fine_horizon, Compare comp = Compare())
+      : fine_(fine_horizon), fine_horizon_(fine_horizon), now_(), comp_(comp) {}
+
+  void add_level(const TTime& bucket, const TTime& horizon) { levels_.push_back(level(bucket, horizon)); }
+
+  void update(const TTime& time, const T& value) {
+    now_ = time;
+    fine_.update(time, value, comp_);
+    for (auto& l : levels_) l.update(time, value, comp_);
+  }
+
+  // The extremum over the given window, which must be within the longest horizon.  The cascade must not be empty.
+  const T& query(const TTime& window) const {
+    assert(!((levels_.empty() ? fine_horizon_ : levels_.back().horizon) < window));
+    if (!(fine_horizon_ < window) || levels_.empty()) return fine_.query(window);
+
+    size_t i = 0;
+    while (i + 1 < levels_.size() && levels_[i].horizon < window) ++i;
+    return levels_[i].query(now_, window, comp_);
+  }
+
+  bool empty() const { return fine_.empty(); }
+
+ private:
+  struct level {
+    TTime bucket, horizon;
+    mono_wedge<TTime, T> closed;  // Extrema of closed buckets, keyed by bucket start.
+    TTime open_start;
+    T open_best;
+    bool open;
+
+    level(const TTime& bucket_width, const TTime& level_horizon)
+        : bucket(bucket_width),
+          horizon(level_horizon),
+          closed(level_horizon + bucket_width),
+          open_start(),
+          open_best(),
+          open(false) {}
+
+    void update(const TTime& time, const T& value, Compare comp) {
+      TTime start = detail::bucket_floor(time, bucket);
+      if (open && open_start < start) {
+        closed.update(open_start, open_best, comp);
+        open = false;
+      }
+      if (!open) {
+        open = true;
+        open_start = start;
+        open_best = value;
+      } else if (!comp(open_best, value)) {
+        open_best = value;
+      }
+    }
+
+    const T& query(const TTime& now, const TTime& window, Compare comp) const {
+      auto i = (now < window) ? closed.begin() : closed.since(detail::window_bucket_floor(now, window, bucket));
+      if (i == closed.end() || comp(open_best, i->second)) return open_best;
+      return i->second;
+    }
+  };
+
+  mono_wedge<TTime, T> fine_;
+  std::vector<level> levels_;
+  TTime fine_horizon_, now_;
+  Compare comp_;
+};
+
+/*
+        handle_wedge<Key, THandle>
 
+        Wedge of handles into a sample store owned by the caller.
+
+                The caller keeps its samples in its own container (EG. a ringbuffer of
+                large records) and numbers them with increasing handles, such as a
+                running sequence number.  The wedge stores only the handles and
+                compares samples through key(handle), so its memory and copy traffic
+                do not depend on the record size, and one store may back several
+                wedges over different fields or windows.
+
+                key must stay valid for every handle in the wedge and for the handle
+                being added.  Handles are compared modulo 2^bits by expire_window.
+*/
+template <class Key, class THandle = std::uint32_t>
+class handle_wedge {
+ public:
+  typedef fixed_ringbuffer<THandle> THandles;
+  typedef typename THandles::size_type size_type;
+  typedef typename THandles::const_iterator const_iterator;
+
+  explicit handle_wedge(Key key = Key()) : handles_(initial_capacity), key_(key) {}
+
+  /*
+          Add a handle, erasing the handles whose keys do not satisfy
+                  comp(element_key, key(handle)).
+  */
   template <class Compare>
-  void max_update(TCollection& wedge, T&& value) {
-    update(wedge, std::forward(value), std::greater<T>());
+  void update(THandle handle, Compare comp) {
+    auto value = key_(handle);
+    auto i = mono_wedge_search(handles_.begin(), handles_.end(), value,
+                               [this, &comp](THandle element, const decltype(value)& val) { return comp(key_(element), val); });
+    size_type erase_count = size_type(handles_.end() - i);
+    handles_.pop_back_n(erase_count);
+    if (handles_.full()) reallocate(2 * handles_.capacity());
+    handles_.push_back(handle);
+  }
+
+  void min_update(THandle handle) { update(handle, std::less<>()); }
+  void max_update(THandle handle) { update(handle, std::greater<>()); }
+
+  // Handle of the extremum, and of the latest sample.  The wedge must not be empty.
+  THandle front() const { return handles_.front(); }
+  THandle back() const { return handles_.back(); }
+
+  const_iterator begin() const { return handles_.begin(); }
+  const_iterator end() const { return handles_.end(); }
+
+  bool empty() const { return handles_.empty(); }
+  size_type size() const { return handles_.size(); }
+
+  void reserve(size_type depth) {
+    if (depth > handles_.capacity()) reallocate(depth);
+  }
+
+  void pop_front() { handles_.pop_front(); }
+
+  // Pop handles less than cutoff, or whose distance to now is window or more.
+  size_type expire_before(THandle cutoff) {
+    return expire_prefix([cutoff](THandle handle) { return handle < cutoff; });
+  }
+
+  size_type expire_window(THandle now, THandle window) {
+    return expire_prefix([now, window](THandle handle) { return !(THandle(now - handle) < window); });
+  }
+
+ private:
+  static const size_type initial_capacity = 16;
+
+  THandles handles_;
+  Key key_;
+
+  template <class Predicate>
+  size_type expire_prefix(Predicate stale) {
+    size_type count =
+        size_type(detail::gallop_partition_point(handles_.begin(), handles_.end(), stale) - handles_.begin());
+    handles_.pop_front_n(count);
+    return count;
+  }
+
+  void reallocate(size_type depth) {
+    THandles larger(depth);
+    for (auto handle : handles_) larger.push_back(handle);
+    handles_.swap(larger);
   }
 };
 
+/*
+        topk_wedge<TTime, T, K, Compare>
+
+        The K most extreme values in a sliding window, generalizing the wedge.
+
+                A sample is dominated by each later sample which it does not satisfy
+                comp(sample, later) against.  Once K later samples dominate it, it can
+                never again be among the top K and is dropped;  with K = 1 this is the
+                rule of mono_wedge_update.  The K most extreme samples in the window are
+                always among those kept.
+
+                Kept samples are sorted into K levels by the number of samples which
+                dominate them.  Each level is a monotonic wedge in its own right:  had
+                a later sample of a level dominated an earlier one, so would all of its
+                own dominators, and the two could not share a level.  A new sample
+                dominates a suffix of each level, which moves up one level, landing
+                after all the samples left there;  the suffix of the top level is
+                dropped.  An update thus touches only the samples it dominates, plus
+                one comparison per level, and each sample moves at most K times.  The
+                amortized cost of an update is O(K), and each level holds at most the
+                window.
+
+                top() merges the heads of the levels with a scalar insertion sort of at
+                most K*(K+1)/2 values;  there is no vectorized path.
+
+                Compare defaults to std::greater, tracking the K largest values.
+*/
+template <class TTime, class T, size_t K, class Compare = std::greater<T> >
+class topk_wedge {
+  static_assert(K > 0, "topk_wedge requires K > 0");
+
+ public:
+  typedef size_t size_type;
+
+  explicit topk_wedge(Compare comp = Compare()) : window_(), windowed_(false), comp_(comp) {}
+
+  // Construct a wedge which expires samples window or more older than the latest.
+  explicit topk_wedge(const TTime& window, Compare comp = Compare()) : window_(window), windowed_(true), comp_(comp) {}
+
+  void update(const TTime& time, const T& value) {
+    if (windowed_) expire_window(time, window_);
+
+    // Lift each level's dominated suffix, starting from the top so that the level above is already trimmed.
+    levels_[K - 1].pop_back_n(levels_[K - 1].dominated(value, comp_));
+    for (size_type j = K - 1; j-- > 0;) {
+      level& from = levels_[j];
+      size_type n = from.dominated(value, comp_);
+      for (size_type i = from.size() - n; i < from.size(); ++i)
+        levels_[j + 1].push_back(std::move(from.entries[i]));
+      from.pop_back_n(n);
+    }
+    levels_[0].push_back(entry{time, value});
+  }
+
+  /*
+          Write the up to K most extreme values in the window to out, best first,
+                  and return their number.  A sample of level j has j dominators at least
+                  as extreme, as do the samples before it in its level, so only the first
+                  K - j samples of level j need be considered.  Those of the undominated
+                  level are already in order.
+  */
+  size_type top(T* out) const {
+    const level& undominated = levels_[0];
+    size_type n = std::min(K, undominated.size());
+    for (size_type i = 0; i < n; ++i) out[i] = undominated.entries[i].value;
+    for (size_type j = 1; j < K; ++j) {
+      const level& l = levels_[j];
+      for (size_type i = 0, end = std::min(K - j, l.size()); i < end; ++i) {
+        const T& value = l.entries[i].value;
+        if (n == K && !comp_(value, out[K - 1])) break;
+        size_type k = (n < K) ? n++ : K - 1;
+        for (; k > 0 && comp_(value, out[k - 1]); --k) out[k] = out[k - 1];
+        out[k] = value;
+      }
+    }
+    return n;
+  }
+
+  // The most extreme value in the window, which heads the undominated level.  The wedge must not be empty.
+  const T& front() const { return levels_[0].entries.front().value; }
+
+  // The latest sample is undominated, and every other sample is older, so the wedge empties with the first level.
+  bool empty() const { return levels_[0].entries.empty(); }
+
+  size_type size() const {
+    size_type total = 0;
+    for (const level& l : levels_) total += l.size();
+    return total;
+  }
+
+  // Reserve room for depth samples in each level.
+  void reserve(size_type depth) {
+    for (level& l : levels_) l.reserve(depth);
+  }
+
+  // Expire samples earlier than cutoff, or window or more older than now.
+  size_type expire_before(const TTime& cutoff) {
+    return expire_prefix([&cutoff](const TTime& time) { return time < cutoff; });
+  }
+
+  size_type expire_window(const TTime& now, const TTime& window) {
+    return expire_prefix([&now, &window](const TTime& time) { return !(now - time < window); });
+  }
+
+ private:
+  static const size_type initial_capacity = 16;
+
+  struct entry {
+    TTime time;
+    T value;
+  };
+
+  // Samples dominated by exactly one number of later samples, in time order, each stored next to its time.
+  struct level {
+    fixed_ringbuffer<entry> entries;
+
+    level() : entries(initial_capacity) {}
+
+    size_type size() const { return entries.size(); }
+
+    /*
+            Number of samples at the back which value dominates.  Every sample
+                    counted is then moved or dropped, so a linear scan costs no more than
+                    that, and beats a galloping search over the few samples at stake.
+    */
+    size_type dominated(const T& value, Compare comp) const {
+      size_type n = 0, count = entries.size();
+      while (n < count && !comp(entries[count - 1 - n].value, value)) ++n;
+      return n;
+    }
+
+    template <class E>
+    void push_back(E&& e) {
+      if (entries.full()) reserve(2 * entries.capacity());
+      entries.push_back(std::forward<E>(e));
+    }
+
+    void pop_back_n(size_type n) { entries.pop_back_n(n); }
+
+    void reserve(size_type depth) {
+      if (depth <= entries.capacity()) return;
+      fixed_ringbuffer<entry> larger(depth);
+      for (auto& e : entries) larger.push_back(std::move(e));
+      entries.swap(larger);
+    }
+  };
+
+  std::array<level, K> levels_;  // levels_[j] holds the samples which j later samples dominate.
+  TTime window_;
+  bool windowed_;
+  Compare comp_;
+
+  template <class Predicate>
+  size_type expire_prefix(Predicate stale) {
+    size_type count = 0;
+    auto stale_entry = [&stale](const entry& e) { return stale(e.time); };
+    for (level& l : levels_) {
+      if (l.entries.empty() || !stale_entry(l.entries.front())) continue;
+      size_type n = size_type(detail::gallop_partition_point(l.entries.begin(), l.entries.end(), stale_entry) -
+                              l.entries.begin());
+      l.entries.pop_front_n(n);
+      count += n;
+    }
+    return count;
+  }
+};
 }  // namespace mono_wedge
 
 #endif  // MONOTONIC_WEDGE_H
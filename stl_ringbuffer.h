@@ -1,14 +1,31 @@
 #ifndef STL_RINGBUFFER_H
 #define STL_RINGBUFFER_H
 
+#include <array>
+#include <cassert>
 #include <cstddef>
-//#include <allocator>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <algorithm>
 #include <iterator>
+#include <type_traits>
+#include <utility>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
 
 /*
-	C++ fixed-size ringbuffer container.
-		Its capacity is always a power of two.
+	C++ fixed-size ringbuffer containers.
+		Their capacity is always a power of two:  fixed_ringbuffer allocates
+		it at run time, static_ringbuffer holds it inline.
 */
 
 namespace mono_wedge
@@ -23,31 +40,21 @@ namespace mono_wedge
 			for (T shift = 1; shift < bits; shift <<= 1) bitfill |= (bitfill >> shift);
 			return bitfill+1;
 		}
-	}
-
-	template<class T, class Allocator = std::allocator<T>>
-	class fixed_ringbuffer
-	{
-	public:
-		typedef       T        value_type;
-		typedef       T&       reference;
-		typedef const T&       const_reference;
 		
-		typedef typename std::allocator_traits<Allocator>::pointer       pointer;
-		typedef typename std::allocator_traits<Allocator>::const_pointer const_pointer;
-		
-		typedef size_t         size_type;
-		typedef std::ptrdiff_t difference_type;
-		typedef Allocator      allocator_type;
+		template<typename T>
+		constexpr T static_power_of_two(const T n, const T power = 1)
+		{
+			return (power >= n) ? power : static_power_of_two(n, T(power << 1));
+		}
 		
-	public:
 		/*
-			Random-access iterator implementation.
+			Random-access iterator implementation, shared by the ringbuffers.
 		*/
 		template<class T_ringbuffer, class T_Value>
-		class _iterator
+		class ring_iterator
 		{
 		public:
+			typedef typename T_ringbuffer::size_type       size_type;
 			typedef typename T_ringbuffer::difference_type difference_type;
 			typedef T_Value                                value_type;
 			typedef T_Value&                               reference;
@@ -55,47 +62,207 @@ namespace mono_wedge
 			typedef std::random_access_iterator_tag        iterator_category;
 		
 		public:
-			_iterator()                                                 : _ring(NULL), _idx(0)     {}
-			_iterator(T_ringbuffer *ring, size_type index)              : _ring(ring), _idx(index) {}
+			ring_iterator()                                                   : _ring(NULL), _idx(0)     {}
+			ring_iterator(T_ringbuffer *ring, size_type index)                : _ring(ring), _idx(index) {}
 			
-			_iterator                 (_iterator      &&o)              : _ring(o._ring), _idx(o._idx) {}
-			_iterator                 (const _iterator &o)              : _ring(o._ring), _idx(o._idx) {}
+			ring_iterator                 (ring_iterator      &&o)            : _ring(o._ring), _idx(o._idx) {}
+			ring_iterator                 (const ring_iterator &o)            : _ring(o._ring), _idx(o._idx) {}
 			
-			_iterator      &operator= (_iterator      &&o)              {_ring = o._ring; _idx = o._idx; return *this;}
-			_iterator      &operator= (const _iterator &o)              {_ring = o._ring; _idx = o._idx; return *this;}
+			ring_iterator  &operator=     (ring_iterator      &&o)            {_ring = o._ring; _idx = o._idx; return *this;}
+			ring_iterator  &operator=     (const ring_iterator &o)            {_ring = o._ring; _idx = o._idx; return *this;}
 			
-			T_Value &       operator* ()                       const    {return  _ring->_get(_idx);}
-			T_Value *       operator->()                       const    {return &_ring->_get(_idx);}
-			T_Value &       operator[](difference_type offset) const    {return * ((*this) + offset);}
+			T_Value &       operator* ()                           const    {return  _ring->_get(_idx);}
+			T_Value *       operator->()                           const    {return &_ring->_get(_idx);}
+			T_Value &       operator[](difference_type offset)     const    {return * ((*this) + offset);}
 			
-			bool            operator==(const _iterator &other) const    {return _idx == other._idx;}
-			bool            operator!=(const _iterator &other) const    {return _idx != other._idx;}
-			bool            operator< (const _iterator &other) const    {return (*this)-other <  0;}
-			bool            operator<=(const _iterator &other) const    {return (*this)-other <= 0;}
-			bool            operator> (const _iterator &other) const    {return (*this)-other >  0;}
-			bool            operator>=(const _iterator &other) const    {return (*this)-other >= 0;}
+			bool            operator==(const ring_iterator &other) const    {return _idx == other._idx;}
+			bool            operator!=(const ring_iterator &other) const    {return _idx != other._idx;}
+			bool            operator< (const ring_iterator &other) const    {return (*this)-other <  0;}
+			bool            operator<=(const ring_iterator &other) const    {return (*this)-other <= 0;}
+			bool            operator> (const ring_iterator &other) const    {return (*this)-other >  0;}
+			bool            operator>=(const ring_iterator &other) const    {return (*this)-other >= 0;}
 			
-			_iterator&      operator++()                                {_idx = _ring->_incr(_idx); return *this;}
-			_iterator&      operator--()                                {_idx = _ring->_decr(_idx); return *this;}
-			_iterator       operator++(int)                             {_iterator r = *this; ++*this; return r;}
-			_iterator       operator--(int)                             {_iterator r = *this; --*this; return r;}
-			_iterator&      operator+=(difference_type offset)          {_idx = _ring->_offset(_idx,  offset); return *this;}
-			_iterator&      operator-=(difference_type offset)          {_idx = _ring->_offset(_idx, -offset); return *this;}
+			ring_iterator&  operator++()                                    {_idx = _ring->_incr(_idx); return *this;}
+			ring_iterator&  operator--()                                    {_idx = _ring->_decr(_idx); return *this;}
+			ring_iterator   operator++(int)                                 {ring_iterator r = *this; ++*this; return r;}
+			ring_iterator   operator--(int)                                 {ring_iterator r = *this; --*this; return r;}
+			ring_iterator&  operator+=(difference_type offset)              {_idx = _ring->_offset(_idx,  offset); return *this;}
+			ring_iterator&  operator-=(difference_type offset)              {_idx = _ring->_offset(_idx, -offset); return *this;}
 			
-			_iterator       operator+ (difference_type offset) const    {_iterator r = *this; r += offset; return r;}
-			_iterator       operator- (difference_type offset) const    {_iterator r = *this; r -= offset; return r;}
-			difference_type operator- (const _iterator &other) const    {return _ring->_difference(_idx, other._idx);}
+			ring_iterator   operator+ (difference_type offset)     const    {ring_iterator r = *this; r += offset; return r;}
+			ring_iterator   operator- (difference_type offset)     const    {ring_iterator r = *this; r -= offset; return r;}
+			difference_type operator- (const ring_iterator &other) const    {return _ring->_difference(_idx, other._idx);}
 			
 		protected:
 			T_ringbuffer *_ring;
 			size_type     _idx;
 		};
+		
+		/*
+			Index math, accessors and mutators shared by the ringbuffers.
+				Derived provides its storage through _data(), its index mask of
+				2*capacity-1 through _mask(), and the message of at() through
+				_throw_out_of_range().  A push which finds no room for n more
+				elements calls _make_room(n), which throws bad_alloc unless
+				Derived hides it with one that grows the storage.
+		*/
+		template<class Derived, class T>
+		class ring_base
+		{
+		public:
+			typedef       T        value_type;
+			typedef       T&       reference;
+			typedef const T&       const_reference;
+			typedef       T*       pointer;
+			typedef const T*       const_pointer;
+			
+			typedef size_t         size_type;
+			typedef std::ptrdiff_t difference_type;
+			
+			typedef ring_iterator<      ring_base,       T> iterator;
+			typedef ring_iterator<const ring_base, const T> const_iterator;
+			
+			typedef std::reverse_iterator<iterator>                    reverse_iterator;
+			typedef std::reverse_iterator<const_iterator>              const_reverse_iterator;
+			
+		public:
+			// Accessors.
+			const_reference operator[](size_type pos) const noexcept    {return _get(_offset(_head, pos));}
+			reference       operator[](size_type pos)       noexcept    {return _get(_offset(_head, pos));}
+			const_reference at        (size_type pos) const             {if (pos >= size()) _derived()._throw_out_of_range(); return (*this)[pos];}
+			reference       at        (size_type pos)                   {if (pos >= size()) _derived()._throw_out_of_range(); return (*this)[pos];}
+			const_reference front     ()              const noexcept    {return _get(_head);}
+			reference       front     ()                    noexcept    {return _get(_head);}
+			const_reference back      ()              const noexcept    {return _get(_decr(_tail));}
+			reference       back      ()                    noexcept    {return _get(_decr(_tail));}
+			
+			// Mutators (no insert / erase / resize!)
+			void clear()          noexcept    {_destroy_n(_head, size(), _trivial()); _head = _tail = 0;}
+			void push_front(const T &v)       {emplace_front(v);}
+			void push_front(T &&v)            {emplace_front(std::move(v));}
+			void push_back (const T &v)       {emplace_back(v);}
+			void push_back (T &&v)            {emplace_back(std::move(v));}
+			void pop_front ()     noexcept    {if (empty()) return; _destroy(&_get(_head)); _head = _incr(_head);}
+			void pop_back  ()     noexcept    {if (empty()) return; _tail = _decr(_tail); _destroy(&_get(_tail));}
+			
+			// Pop up to n elements at once; for trivially destructible types this only moves an index.
+			void pop_front_n(size_type n) noexcept    {n = std::min(n, size()); _destroy_n(_head, n, _trivial()); _head = _offset(_head, n);}
+			void pop_back_n (size_type n) noexcept    {n = std::min(n, size()); _tail = _offset(_tail, -difference_type(n)); _destroy_n(_tail, n, _trivial());}
+			
+			// Block transfers, copying at most two contiguous runs.  push_back_n makes room for all n values first;
+			//   pop_front_n moves up to n values out, returning how many were popped.
+			void push_back_n(const T *values, size_type n)
+			{
+				if (n > capacity() - size()) _derived()._make_room(n);
+				size_type first = std::min(n, capacity() - _slot(_tail));
+				std::uninitialized_copy_n(values,         first,     &_get(_tail)); _tail = _offset(_tail, first);
+				std::uninitialized_copy_n(values + first, n - first, &_get(_tail)); _tail = _offset(_tail, n - first);
+			}
+			size_type pop_front_n(T *out, size_type n) noexcept(std::is_nothrow_move_assignable<T>::value)
+			{
+				n = std::min(n, size());
+				size_type first = std::min(n, capacity() - _slot(_head));
+				std::move(&_get(_head), &_get(_head) + first, out);
+				std::move(&_get(0),     &_get(0) + (n - first), out + first);
+				pop_front_n(n);
+				return n;
+			}
+			
+#if defined(__cpp_lib_span)
+			// The live region as contiguous spans from the front; the second is empty unless the region wraps.
+			std::pair<std::span<      T>, std::span<      T>> as_spans()       noexcept    {size_type first = _first_run(); return {{&_get(_head), first}, {&_get(0), size() - first}};}
+			std::pair<std::span<const T>, std::span<const T>> as_spans() const noexcept    {size_type first = _first_run(); return {{&_get(_head), first}, {&_get(0), size() - first}};}
+#endif
+			
+			template<class... Args>
+			reference emplace_front(Args&&... args)    {if (full()) _derived()._make_room(1); _create(&_get(_decr(_head)), std::forward<Args>(args)...); _head = _decr(_head); return front();}
+			template<class... Args>
+			reference emplace_back (Args&&... args)    {if (full()) _derived()._make_room(1); _create(&_get(_tail), std::forward<Args>(args)...); _tail = _incr(_tail); return back();}
+			
+			// Non-throwing variant of push_back, which returns false when full rather than making room.
+			bool try_push_back(const T &v) noexcept(std::is_nothrow_copy_constructible<T>::value)
+				{if (full()) return false; _create(&_get(_tail), v); _tail = _incr(_tail); return true;}
+			
+			// Size and capacity.
+			bool           empty   () const noexcept    {return _head == _tail;}
+			bool           full    () const noexcept    {return _head == (_tail^capacity());}
+			size_type      size    () const noexcept    {return _size(_head, _tail);}
+			size_type      capacity() const noexcept    {return (_mask()+1) >> 1;}
+			
+			// Iterators.
+			iterator       begin   ()       noexcept    {return       iterator(this, _head);}
+			iterator       end     ()       noexcept    {return       iterator(this, _tail);}
+			const_iterator begin   () const noexcept    {return const_iterator(this, _head);}
+			const_iterator end     () const noexcept    {return const_iterator(this, _tail);}
+			const_iterator cbegin  () const noexcept    {return const_iterator(this, _head);}
+			const_iterator cend    () const noexcept    {return const_iterator(this, _tail);}
+			
+			// Reverse iterators.
+			reverse_iterator       rbegin   ()          {return reverse_iterator(end());}
+			reverse_iterator       rend     ()          {return reverse_iterator(begin());}
+			const_reverse_iterator rbegin   () const    {return const_reverse_iterator(end());}
+			const_reverse_iterator rend     () const    {return const_reverse_iterator(begin());}
+			const_reverse_iterator crbegin  () const    {return const_reverse_iterator(cend());}
+			const_reverse_iterator crend    () const    {return const_reverse_iterator(cbegin());}
+			
+		protected:
+			ring_base() noexcept : _head(0), _tail(0) {}
+			
+			size_type _head;
+			size_type _tail;
+			
+			void _make_room(size_type)    {throw std::bad_alloc();}
+			
+		private:
+			friend class ring_iterator<      ring_base,       T>;
+			friend class ring_iterator<const ring_base, const T>;
+			
+			const Derived &_derived() const    {return static_cast<const Derived&>(*this);}
+			      Derived &_derived()          {return static_cast<      Derived&>(*this);}
+			
+			// Create & destroy
+			template<class... Args>
+			void            _create (T *t, Args&&... args)    {new (t) T(std::forward<Args>(args)...);}
+			void            _destroy(T *t)                {t->~T();}
+			
+			typedef typename std::is_trivially_destructible<T>::type _trivial;
+			void _destroy_n(size_type,     size_type,   std::true_type)     {}
+			void _destroy_n(size_type pos, size_type n, std::false_type)    {for (; n--; pos = _incr(pos)) _destroy(&_get(pos));}
+			
+			size_type _first_run() const    {return std::min(size(), capacity() - _slot(_head));}
+			
+			// Access by internal index
+			const_reference _get(size_type index) const    {return _derived()._data()[_slot(index)];}
+			reference       _get(size_type index)          {return _derived()._data()[_slot(index)];}
+			
+			// Index math implementation
+			size_type _mask() const    {return _derived()._mask();}
+			
+			size_type _slot(size_type pos)                  const    {return pos               & (_mask()>>1);}
+			size_type _incr(size_type pos)                  const    {return (pos + 1)         & _mask();}
+			size_type _decr(size_type pos)                  const    {return (pos + _mask())   & _mask();}
+			size_type _size(size_type begin, size_type end) const    {return (end-begin)       & _mask();}
+			
+			size_type _offset(size_type pos, difference_type offset) const    {return size_type((difference_type(pos) + offset) & _mask());}
+			size_type _offset(size_type pos, size_type       offset) const    {return size_type(pos + offset) & _mask();}
+			
+		 	difference_type _difference(size_type pos_term, size_type neg_term) const
+				{return difference_type(_size(_head, pos_term)) - difference_type(_size(_head, neg_term));}
+				// size_type delta = _size(pos1, pos2), half = _mask()>>1; return difference_type(delta)-((delta>half) ? (half+1) : 0);
+		};
+	}
 	
-		typedef _iterator<      fixed_ringbuffer<T, Allocator>,       T> iterator;
-		typedef _iterator<const fixed_ringbuffer<T, Allocator>, const T> const_iterator;
+	template<class T, class Allocator = std::allocator<T>>
+	class fixed_ringbuffer : public detail::ring_base<fixed_ringbuffer<T, Allocator>, T>
+	{
+		typedef detail::ring_base<fixed_ringbuffer<T, Allocator>, T> base;
 		
-		typedef std::reverse_iterator<iterator>                    reverse_iterator;
-		typedef std::reverse_iterator<const_iterator>              const_reverse_iterator;
+	public:
+		typedef typename std::allocator_traits<Allocator>::pointer       pointer;
+		typedef typename std::allocator_traits<Allocator>::const_pointer const_pointer;
+		
+		typedef typename base::size_type size_type;
+		typedef Allocator                allocator_type;
 		
 	public:
 		/*
@@ -105,104 +272,407 @@ namespace mono_wedge
 			_alloc(alloc)
 		{
 			_ind_bits = (detail::next_power_of_two(min_capacity) << 1) - 1;
-			_store = _alloc.allocate(capacity());
-			_head = 0;
-			_tail = 0;
+			_store = _alloc.allocate(this->capacity());
+		}
+		
+		fixed_ringbuffer(const fixed_ringbuffer &other) :
+			_alloc(other._alloc)
+		{
+			_ind_bits = other._ind_bits;
+			_store = _alloc.allocate(this->capacity());
+			for (auto &t : other) this->push_back(t);
+		}
+		
+		fixed_ringbuffer &operator=(const fixed_ringbuffer &other)
+		{
+			fixed_ringbuffer copy(other);
+			swap(copy);
+			return *this;
+		}
+		
+		// Moving takes the storage, leaving the source empty with no capacity.
+		fixed_ringbuffer(fixed_ringbuffer &&other) noexcept :
+			_alloc(std::move(other._alloc)), _store(other._store), _ind_bits(other._ind_bits)
+		{
+			this->_head = other._head;
+			this->_tail = other._tail;
+			other._store = NULL;
+			other._ind_bits = other._head = other._tail = 0;
+		}
+		
+		fixed_ringbuffer &operator=(fixed_ringbuffer &&other) noexcept
+		{
+			fixed_ringbuffer moved(std::move(other));
+			swap(moved);
+			return *this;
 		}
 		
+		allocator_type get_allocator() const    {return _alloc;}
+		
 		~fixed_ringbuffer()
 		{
 			if (_store)
 			{
-				clear();
-				_alloc.deallocate(_store, capacity());
+				this->clear();
+				_alloc.deallocate(_store, this->capacity());
 			}
 		}
 		
+		void swap(fixed_ringbuffer &other) noexcept
+		{
+			std::swap(_alloc,       other._alloc);
+			std::swap(_store,       other._store);
+			std::swap(this->_head,  other._head);
+			std::swap(this->_tail,  other._tail);
+			std::swap(_ind_bits,    other._ind_bits);
+		}
+		
+		size_type max_size() const noexcept    {return this->capacity();}
+		
+	private:
+		Allocator _alloc;
+		T        *_store;
+		size_type _ind_bits; // Bits used to represent element index.  (2*capacity-1)
+		
+	private:
+		friend class detail::ring_base<fixed_ringbuffer<T, Allocator>, T>;
+		
+		T        *_data() const noexcept    {return _store;}
+		size_type _mask() const noexcept    {return _ind_bits;}
+		
+		void _throw_out_of_range() const    {throw std::out_of_range("fixed_ringbuffer::at() out of range");}
+	};
+	
+	/*
+		Ringbuffer with a capacity fixed at compile time and inline storage.
+			Its capacity is the next power of two of at least N, so the index
+			masks are constants, and it lives in one object with no allocation.
+	*/
+	template<class T, size_t N>
+	class static_ringbuffer : public detail::ring_base<static_ringbuffer<T, N>, T>
+	{
+		typedef detail::ring_base<static_ringbuffer<T, N>, T> base;
+		
+	public:
+		typedef typename base::size_type size_type;
+		
+		static const size_type static_capacity = detail::static_power_of_two<size_type>(N);
+		
+	public:
+		/*
+			Public interface.  The constructor taking a capacity mirrors that of
+				fixed_ringbuffer; it must not exceed the static capacity.
+		*/
+		static_ringbuffer() noexcept                                   {}
+		explicit static_ringbuffer(size_type min_capacity) noexcept    {assert(min_capacity <= static_capacity); (void) min_capacity;}
+		
+		static_ringbuffer(const static_ringbuffer &other) : base()
+		{
+			for (auto &t : other) this->push_back(t);
+		}
+		
+		static_ringbuffer &operator=(const static_ringbuffer &other)
+		{
+			if (this != &other)
+			{
+				this->clear();
+				for (auto &t : other) this->push_back(t);
+			}
+			return *this;
+		}
+		
+		// Moving moves the elements, leaving the source empty.
+		static_ringbuffer(static_ringbuffer &&other) noexcept(std::is_nothrow_move_constructible<T>::value) : base()
+		{
+			for (auto &t : other) this->emplace_back(std::move(t));
+			other.clear();
+		}
+		
+		static_ringbuffer &operator=(static_ringbuffer &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+		{
+			if (this != &other)
+			{
+				this->clear();
+				for (auto &t : other) this->emplace_back(std::move(t));
+				other.clear();
+			}
+			return *this;
+		}
+		
+		~static_ringbuffer()    {this->clear();}
+		
+		void swap(static_ringbuffer &other)
+		{
+			static_ringbuffer tmp(std::move(other));
+			other = std::move(*this);
+			*this = std::move(tmp);
+		}
+		
+		size_type max_size() const noexcept    {return static_capacity;}
+		
+	private:
+		static const size_type _ind_bits = 2*static_capacity - 1; // Bits used to represent element index.
+		
+		std::array<typename std::aligned_storage<sizeof(T), alignof(T)>::type, static_capacity> _store;
+		
+	private:
+		friend class detail::ring_base<static_ringbuffer<T, N>, T>;
+		
+		// Storage with a constant mask
+		const T         *_data() const noexcept    {return reinterpret_cast<const T*>(_store.data());}
+		      T         *_data()       noexcept    {return reinterpret_cast<      T*>(_store.data());}
+		static size_type _mask()       noexcept    {return _ind_bits;}
+		
+		void _throw_out_of_range() const    {throw std::out_of_range("static_ringbuffer::at() out of range");}
+	};
+	
+	template<class T, size_t N> const typename static_ringbuffer<T, N>::size_type static_ringbuffer<T, N>::static_capacity;
+	template<class T, size_t N> const typename static_ringbuffer<T, N>::size_type static_ringbuffer<T, N>::_ind_bits;
+	
+	
+	/*
+		Ringbuffer which doubles its storage when full instead of throwing, so
+			that memory tracks the depth actually used rather than a worst case.
+			Growth relocates the elements, invalidating iterators and references.
+			
+			With Shrink, pops halve the storage while a quarter of it or less is
+			in use, down to shrink_floor slots.  Each relocation is paid for by
+			the pushes or pops since the last one, as with doubling.
+	*/
+	template<class T, class Allocator = std::allocator<T>, bool Shrink = false>
+	class growable_ringbuffer
+	{
+	public:
+		typedef fixed_ringbuffer<T, Allocator> ring_type;
+		
+		typedef typename ring_type::value_type             value_type;
+		typedef typename ring_type::reference              reference;
+		typedef typename ring_type::const_reference        const_reference;
+		typedef typename ring_type::pointer                pointer;
+		typedef typename ring_type::const_pointer          const_pointer;
+		
+		typedef typename ring_type::size_type              size_type;
+		typedef typename ring_type::difference_type        difference_type;
+		typedef typename ring_type::allocator_type         allocator_type;
+		
+		typedef typename ring_type::iterator               iterator;
+		typedef typename ring_type::const_iterator         const_iterator;
+		typedef typename ring_type::reverse_iterator       reverse_iterator;
+		typedef typename ring_type::const_reverse_iterator const_reverse_iterator;
+		
+		static const size_type shrink_floor = 8;
+		
+	public:
+		/*
+			Public interface.  The capacity given is only the initial one.
+		*/
+		explicit growable_ringbuffer(size_type min_capacity = shrink_floor, const Allocator &alloc = Allocator()) :
+			_ring(std::max<size_type>(min_capacity, 1), alloc) {}
+		
 		// Accessors.
-		const_reference operator[](size_type pos) const    {return _get(pos);}
-		reference       operator[](size_type pos)          {return _get(pos);}
-		const_reference at        (size_type pos) const    {if (pos >= size()) _throw_out_of_range(); return _get(pos);}
-		reference       at        (size_type pos)          {if (pos >= size()) _throw_out_of_range(); return _get(pos);}
-		const_reference front     ()              const    {return _get(_head);}
-		reference       front     ()                       {return _get(_head);}
-		const_reference back      ()              const    {return _get(_decr(_tail, _ind_bits));}
-		reference       back      ()                       {return _get(_decr(_tail, _ind_bits));}
-		
-		// Mutators (no insert / erase / resize!)
-		void clear()                   {for (auto &t : *this) {_destroy(&t);} _head = _tail = 0;}
-		void push_front(const T &v)    {if (full()) throw std::bad_alloc(); _head = _decr(_head); _create(&_get(_head), v);}
-		void push_back (const T &v)    {if (full()) throw std::bad_alloc(); _create(&_get(_tail), v); _tail = _incr(_tail);}
-		void pop_front ()              {if (empty()) return; _destroy(&_get(_head)); _head = _incr(_head);}
-		void pop_back  ()              {if (empty()) return; _tail = _decr(_tail); _destroy(&_get(_tail));}
-		
-		void swap(fixed_ringbuffer &other)
-		{
-			std::swap(_alloc,    other._alloc);
-			std::swap(_store,    other._store);
-			std::swap(_head,     other._head);
-			std::swap(_tail,     other._tail);
-			std::swap(_ind_bits, other._ind_bits);
-		}
-		
-		// Size and capacity.
-		bool           empty   () const    {return _head == _tail;}
-		bool           full    () const    {return _head == (_tail^capacity());}
-		size_type      size    () const    {return _size(_head, _tail, _ind_bits);}
-		size_type      max_size() const    {return capacity();}
-		size_type      capacity() const    {return (_ind_bits+1) >> 1;}
+		const_reference operator[](size_type pos) const noexcept    {return _ring[pos];}
+		reference       operator[](size_type pos)       noexcept    {return _ring[pos];}
+		const_reference at        (size_type pos) const             {return _ring.at(pos);}
+		reference       at        (size_type pos)                   {return _ring.at(pos);}
+		const_reference front     ()              const noexcept    {return _ring.front();}
+		reference       front     ()                    noexcept    {return _ring.front();}
+		const_reference back      ()              const noexcept    {return _ring.back();}
+		reference       back      ()                    noexcept    {return _ring.back();}
+		
+		// Mutators (no insert / erase / resize!)  Only pops with Shrink may relocate, and so throw.
+		void clear()          noexcept    {_ring.clear();}
+		void push_front(const T &v)       {emplace_front(v);}
+		void push_front(T &&v)            {emplace_front(std::move(v));}
+		void push_back (const T &v)       {emplace_back(v);}
+		void push_back (T &&v)            {emplace_back(std::move(v));}
+		void pop_front ()     noexcept(!Shrink)    {_ring.pop_front(); _shrink();}
+		void pop_back  ()     noexcept(!Shrink)    {_ring.pop_back();  _shrink();}
+		
+		void      pop_front_n(size_type n) noexcept(!Shrink)    {_ring.pop_front_n(n); _shrink();}
+		void      pop_back_n (size_type n) noexcept(!Shrink)    {_ring.pop_back_n(n);  _shrink();}
+		size_type pop_front_n(T *out, size_type n)              {n = _ring.pop_front_n(out, n); _shrink(); return n;}
+		void      push_back_n(const T *values, size_type n)     {reserve(size() + n); _ring.push_back_n(values, n);}
+		
+		template<class... Args>
+		reference emplace_front(Args&&... args)    {if (_ring.full()) _relocate(2 * capacity()); return _ring.emplace_front(std::forward<Args>(args)...);}
+		template<class... Args>
+		reference emplace_back (Args&&... args)    {if (_ring.full()) _relocate(2 * capacity()); return _ring.emplace_back (std::forward<Args>(args)...);}
+		
+		void swap(growable_ringbuffer &other) noexcept    {_ring.swap(other._ring);}
+		
+		// Grow to hold at least min_capacity elements, or release the storage not in use.
+		void reserve(size_type min_capacity)    {if (min_capacity > capacity()) _relocate(std::max(min_capacity, 2 * capacity()));}
+		void shrink_to_fit()                    {size_type fit = std::max<size_type>(size(), shrink_floor); if (detail::next_power_of_two(fit) < capacity()) _relocate(fit);}
+		
+		// Size and capacity.  The ring is full only in the sense that the next push relocates it.
+		bool           empty   () const noexcept    {return _ring.empty();}
+		bool           full    () const noexcept    {return _ring.full();}
+		size_type      size    () const noexcept    {return _ring.size();}
+		size_type      max_size() const noexcept    {return std::allocator_traits<Allocator>::max_size(_ring.get_allocator());}
+		size_type      capacity() const noexcept    {return _ring.capacity();}
 		
 		// Iterators.
-		iterator       begin   ()          {return       iterator(this, _head);}
-		iterator       end     ()          {return       iterator(this, _tail);}
-		const_iterator begin   () const    {return const_iterator(this, _head);}
-		const_iterator end     () const    {return const_iterator(this, _tail);}
-		const_iterator cbegin  () const    {return const_iterator(this, _head);}
-		const_iterator cend    () const    {return const_iterator(this, _tail);}
+		iterator       begin   ()       noexcept    {return _ring.begin();}
+		iterator       end     ()       noexcept    {return _ring.end();}
+		const_iterator begin   () const noexcept    {return _ring.begin();}
+		const_iterator end     () const noexcept    {return _ring.end();}
+		const_iterator cbegin  () const noexcept    {return _ring.cbegin();}
+		const_iterator cend    () const noexcept    {return _ring.cend();}
 		
 		// Reverse iterators.
-		reverse_iterator       rbegin   ()          {return reverse_iterator(end());}
-		reverse_iterator       rend     ()          {return reverse_iterator(begin());}
-		const_reverse_iterator rbegin   () const    {return const_reverse_iterator(end());}
-		const_reverse_iterator rend     () const    {return const_reverse_iterator(begin());}
-		const_reverse_iterator crbegin  () const    {return const_reverse_iterator(cend());}
-		const_reverse_iterator crend    () const    {return const_reverse_iterator(cbegin());}
+		reverse_iterator       rbegin   ()          {return _ring.rbegin();}
+		reverse_iterator       rend     ()          {return _ring.rend();}
+		const_reverse_iterator rbegin   () const    {return _ring.rbegin();}
+		const_reverse_iterator rend     () const    {return _ring.rend();}
+		const_reverse_iterator crbegin  () const    {return _ring.crbegin();}
+		const_reverse_iterator crend    () const    {return _ring.crend();}
 		
 	private:
-		Allocator _alloc;
-		T        *_store;
+		ring_type _ring;
+		
+	private:
+		// Move the elements into a new store of at least the given capacity; the front lands at its start.
+		void _relocate(size_type min_capacity)
+		{
+			ring_type relocated(min_capacity, _ring.get_allocator());
+			for (auto &t : _ring) relocated.emplace_back(std::move(t));
+			_ring.swap(relocated);
+		}
+		
+		void _shrink()
+		{
+			if (!Shrink) return;
+			size_type target = capacity();
+			while (target > shrink_floor && size() <= target / 4) target /= 2;
+			if (target < capacity()) _relocate(target);
+		}
+	};
+	
+	template<class T, class Allocator, bool Shrink> const typename growable_ringbuffer<T, Allocator, Shrink>::size_type growable_ringbuffer<T, Allocator, Shrink>::shrink_floor;
+	
+	
+	/*
+		Ringbuffer with room for N elements inline, which spills to the heap
+			only once it outgrows them and doubles from there when full.  Shallow
+			rings thus never touch the allocator.  Spilling relocates the elements,
+			invalidating iterators and references;  shrink_to_fit brings them back
+			inline once they fit.
+	*/
+	template<class T, size_t N>
+	class small_ringbuffer : public detail::ring_base<small_ringbuffer<T, N>, T>
+	{
+		typedef detail::ring_base<small_ringbuffer<T, N>, T> base;
+		
+	public:
+		typedef typename base::size_type size_type;
+		
+		static const size_type inline_capacity = detail::static_power_of_two<size_type>(N);
+		
+	public:
+		/*
+			Public interface.  A capacity beyond the inline one spills at once.
+				The ring is full only in the sense that the next push relocates it,
+				and try_push_back returns false rather than spill.
+		*/
+		explicit small_ringbuffer(size_type min_capacity = inline_capacity)    {_reset(); if (min_capacity > inline_capacity) _relocate(min_capacity);}
+		
+		small_ringbuffer(const small_ringbuffer &other) : base()
+		{
+			_reset();
+			reserve(other.size());
+			for (auto &t : other) this->push_back(t);
+		}
+		
+		small_ringbuffer &operator=(const small_ringbuffer &other)
+		{
+			small_ringbuffer copy(other);
+			swap(copy);
+			return *this;
+		}
+		
+		// Moving takes spilled storage, or else moves the inline elements, leaving the source empty.
+		small_ringbuffer(small_ringbuffer &&other) noexcept(std::is_nothrow_move_constructible<T>::value) : base()
+			{_reset(); _take(other);}
+		
+		small_ringbuffer &operator=(small_ringbuffer &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+			{if (this != &other) {_release(); _take(other);} return *this;}
+		
+		~small_ringbuffer()    {_release();}
+		
+		void swap(small_ringbuffer &other)
+		{
+			if (_spilled() && other._spilled())
+			{
+				std::swap(_store,       other._store);
+				std::swap(this->_head,  other._head);
+				std::swap(this->_tail,  other._tail);
+				std::swap(_ind_bits,    other._ind_bits);
+				return;
+			}
+			small_ringbuffer tmp(std::move(other));
+			other._take(*this);
+			_take(tmp);
+		}
+		
+		// Spill to hold at least min_capacity elements, or return inline once the elements fit.
+		void reserve(size_type min_capacity)    {if (min_capacity > this->capacity()) _relocate(std::max(min_capacity, 2 * this->capacity()));}
+		void shrink_to_fit()                    {size_type fit = std::max(this->size(), inline_capacity); if (_spilled() && detail::next_power_of_two(fit) < this->capacity()) _relocate(fit);}
+		
+		size_type max_size() const noexcept    {return std::allocator_traits<std::allocator<T>>::max_size(std::allocator<T>());}
+		
+	private:
+		T        *_store;    // Points to _inline until the ring spills.
 		size_type _ind_bits; // Bits used to represent element index.  (2*capacity-1)
-		size_type _head;
-		size_type _tail;
+		
+		std::array<typename std::aligned_storage<sizeof(T), alignof(T)>::type, inline_capacity> _inline;
 		
 	private:
-		friend class _iterator<      fixed_ringbuffer<T, Allocator>,       T>;
-		friend class _iterator<const fixed_ringbuffer<T, Allocator>, const T>;
+		friend class detail::ring_base<small_ringbuffer<T, N>, T>;
 		
-		// Create & destroy
-		void            _create (T *t)                {new (t) T();}
-		void            _create (T *t, const T &v)    {new (t) T(v);}
-		void            _destroy(T *t)                {t->~T();}
+		T        *_data() const noexcept    {return _store;}
+		size_type _mask() const noexcept    {return _ind_bits;}
 		
-		void _throw_out_of_range()    {throw std::out_of_range("fixed_ringbuffer::at() out of range");}
+		void _make_room(size_type n)    {reserve(this->size() + n);}
 		
-		// Access by internal index
-		const_reference _get(size_type index) const    {return _store[_slot(index)];}
-		reference       _get(size_type index)          {return _store[_slot(index)];}
+		void _throw_out_of_range() const    {throw std::out_of_range("small_ringbuffer::at() out of range");}
 		
-		// Index math implementation
-		size_type _slot(size_type pos)                  const    {return pos               & (_ind_bits>>1);}
-		size_type _incr(size_type pos)                  const    {return (pos + 1)         & _ind_bits;}
-		size_type _decr(size_type pos)                  const    {return (pos + _ind_bits) & _ind_bits;}
-		size_type _size(size_type begin, size_type end) const    {return (end-begin)       & _ind_bits;}
+		// Storage management.  _reset points an empty ring at its inline storage.
+		T   *_inline_store()          {return reinterpret_cast<T*>(_inline.data());}
+		bool _spilled()       const   {return _store != reinterpret_cast<const T*>(_inline.data());}
+		void _reset()                 {_store = _inline_store(); _ind_bits = 2*inline_capacity - 1; this->_head = this->_tail = 0;}
+		void _release()               {this->clear(); if (_spilled()) std::allocator<T>().deallocate(_store, this->capacity()); _reset();}
 		
-		size_type _offset(size_type pos, difference_type offset) const    {return size_type((difference_type(pos) + offset) & _ind_bits);}
-		size_type _offset(size_type pos, size_type       offset) const    {return size_type(pos + offset) & _ind_bits;}
+		// Move the elements to a store of at least the given capacity, which is inline if it fits there.
+		void _relocate(size_type min_capacity)
+		{
+			size_type capacity = std::max(detail::next_power_of_two(min_capacity), inline_capacity);
+			T *store = (capacity == inline_capacity) ? _inline_store() : std::allocator<T>().allocate(capacity);
+			size_type count = 0;
+			for (auto &t : *this) new (store + count++) T(std::move(t));
+			this->clear();
+			if (_spilled()) std::allocator<T>().deallocate(_store, this->capacity());
+			_store = store;
+			_ind_bits = 2*capacity - 1;
+			this->_tail = count;
+		}
 		
-	 	difference_type _difference(size_type pos_term, size_type neg_term) const
-			{return difference_type(_size(_head, pos_term)) - difference_type(_size(_head, neg_term));}
-			// size_type delta = _size(pos1, pos2), half = _ind_bits>>1; return difference_type(delta)-((delta>half) ? (half+1) : 0);
+		// Take the elements of other, leaving it empty;  this ring must be empty and inline.
+		void _take(small_ringbuffer &other)
+		{
+			if (other._spilled())
+			{
+				_store = other._store; _ind_bits = other._ind_bits; this->_head = other._head; this->_tail = other._tail;
+				other._reset();
+			}
+			else
+			{
+				for (auto &t : other) this->emplace_back(std::move(t));
+				other.clear();
+			}
+		}
 	};
+	
+	template<class T, size_t N> const typename small_ringbuffer<T, N>::size_type small_ringbuffer<T, N>::inline_capacity;
 }
 
 
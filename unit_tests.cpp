@@ -9,6 +9,8 @@
 #include <iostream>
 
 #include <vector>
+#include <set>
+#include <string>
 
 #define USE_RINGBUFFER 1
 
@@ -18,24 +20,95 @@
 	#include <deque>
 #endif
 
-#include <cstdlib> // For rand()
+#include <cstdlib> // For rand(), malloc()
+#include <new>
 #include <cmath>   // For sin()
 
 #include "mono_wedge.h"
+#include "window_aggregate.h"
+#include "mirrored_ringbuffer.h"
+#include "van_herk.h"
 
 using namespace mono_wedge;
 
+// Count global allocations, so tests can check that real-time paths never allocate
+static unsigned long allocationCount = 0;
+
+// GCC misreports the replacements as mismatched with free wherever it inlines them
+#if defined(__GNUC__)
+	#define NO_INLINE __attribute__((noinline))
+#else
+	#define NO_INLINE
+#endif
+
+NO_INLINE void *operator new(std::size_t size)
+{
+	++allocationCount;
+	if (void *p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+NO_INLINE void operator delete(void *p) noexcept                 {std::free(p);}
+NO_INLINE void operator delete(void *p, std::size_t) noexcept    {std::free(p);}
+
 struct Sample
 {
 	unsigned time;
 	float    value;
+};
+
+// Sample with a heap payload, counting its copies
+struct Labeled
+{
+	float              value;
+	std::vector<float> payload;
 	
-	bool operator<(const Sample &o) const    {return value < o.value;}
-	bool operator>(const Sample &o) const    {return value > o.value;}
+	static unsigned long copies;
+	
+	Labeled(float v) : value(v), payload(8, v) {}
+	Labeled(const Labeled &o) : value(o.value), payload(o.payload)    {++copies;}
+	Labeled(Labeled &&o) = default;
+	Labeled &operator=(const Labeled &o)    {value = o.value; payload = o.payload; ++copies; return *this;}
+	Labeled &operator=(Labeled &&o) = default;
 };
+unsigned long Labeled::copies = 0;
+
+// Value counting its live instances, so tests can check that rings destroy what they pop
+struct Tracked
+{
+	float value;
+	
+	static long live;
+	
+	Tracked(float v) : value(v)                  {++live;}
+	Tracked(const Tracked &o) : value(o.value)    {++live;}
+	~Tracked()                                   {--live;}
+};
+long Tracked::live = 0;
 
 typedef std::vector<float> Signal;
 
+template<class T, class Quantize>
+bool test_van_herk(const Signal &signal, unsigned interval,
+	const Signal &refMin, const Signal &refMax, Quantize quantize, const char *name)
+{
+	std::vector<T> in(signal.size()), outMin(signal.size()), outMax(signal.size());
+	for (unsigned t = 0; t < signal.size(); ++t) in[t] = quantize(signal[t]);
+	
+	rolling_min(in.data(), outMin.data(), in.size(), interval);
+	rolling_max(in.data(), outMax.data(), in.size(), interval);
+	
+	for (unsigned t = 0; t < signal.size(); ++t)
+	{
+		if (outMin[t] != quantize(refMin[t]) || outMax[t] != quantize(refMax[t]))
+		{
+			std::cout << "      (van Herk " << name << " inconsistent at t=" << t << ")" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 bool test(const Signal &signal, unsigned interval = 0)
 {
 	bool success = true;
@@ -52,6 +125,24 @@ bool test(const Signal &signal, unsigned interval = 0)
 		max_wedge;
 #endif
 	
+	Signal refMins, refMaxs;
+	
+	minmax_wedge<unsigned, float> minmax(interval);
+	::mono_wedge::mono_wedge<unsigned, float> max_class;
+	::mono_wedge::mono_wedge<unsigned, Sample, float> min_records(interval), max_magnitude(interval);
+	auto magnitude = [](const Sample &s) {return std::abs(s.value);};
+	
+	// Real-time wedge destroying at most one erased sample per call
+	::mono_wedge::mono_wedge<unsigned, float> rt_min(interval);
+	rt_min.reserve(interval);
+	rt_min.set_work_limit(1);
+	sample_wedge<float> min_samples(interval), max_samples(interval);
+	
+	// Handle wedges over one shared store of the last interval samples
+	fixed_ringbuffer<Sample> store(interval);
+	auto storeKey = [&store](unsigned handle) {return store[handle - store.front().time].value;};
+	handle_wedge<decltype(storeKey), unsigned> min_handles(storeKey), max_handles(storeKey);
+	
 	for (unsigned t = 0; t < signal.size(); ++t)
 	{
 		float value = signal[t];
@@ -60,19 +151,38 @@ bool test(const Signal &signal, unsigned interval = 0)
 		
 		// Pop old samples
 		while (!min_wedge.empty() && t - min_wedge.front().time >= interval) min_wedge.pop_front();
-		while (!min_wedge.empty() && t - max_wedge.front().time >= interval) max_wedge.pop_front();
+		while (!max_wedge.empty() && t - max_wedge.front().time >= interval) max_wedge.pop_front();
+		
+		if (t >= interval) max_class.expire_before(t - interval + 1);
 		
 		// Update the wedge
-		min_wedge_update(min_wedge, sample);
-		max_wedge_update(max_wedge, sample);
+		min_wedge_update(min_wedge, sample, &Sample::value);
+		max_wedge_update(max_wedge, sample, &Sample::value);
+		min_records.min_update(t, sample, &Sample::value);
+		max_magnitude.max_update(t, sample, magnitude);
+		minmax.update(t, value);
+		max_class.max_update(t, value);
+		rt_min.min_update(t, value);
+		min_samples.min_update(value);
+		max_samples.max_update(value);
+		
+		if (store.full()) store.pop_front();
+		store.push_back(sample);
+		min_handles.expire_window(t, interval);
+		max_handles.expire_window(t, interval);
+		min_handles.min_update(t);
+		max_handles.max_update(t);
 		
 		// Compare wedge result with actual min/max
-		float refMin = 1e18f, refMax = -1e18f;
+		float refMin = 1e18f, refMax = -1e18f, refMagnitude = 0.f;
 		for (unsigned ot = t-std::min(t, interval-1); ot <= t; ++ot)
 		{
 			refMin = std::min(refMin, signal[ot]);
 			refMax = std::max(refMax, signal[ot]);
+			refMagnitude = std::max(refMagnitude, std::abs(signal[ot]));
 		}
+		refMins.push_back(refMin);
+		refMaxs.push_back(refMax);
 		
 		if (refMin != min_wedge.front().value)
 		{
@@ -90,6 +200,326 @@ bool test(const Signal &signal, unsigned interval = 0)
 			success = false;
 			//break;
 		}
+		if (refMax != max_class.front_value())
+		{
+			std::cout << "      (class max inconsistent at t=" << t
+				<< ": wedge-max=" << max_class.front_value() << ", actual=" << refMax
+				<< std::endl;
+			success = false;
+		}
+		if (refMin != rt_min.front_value() || value != rt_min.back_value() || rt_min.capacity() != interval)
+		{
+			std::cout << "      (real-time min inconsistent at t=" << t
+				<< ": wedge-min=" << rt_min.front_value() << ", actual=" << refMin
+				<< std::endl;
+			success = false;
+		}
+		// Query a shorter horizon from the class wedge
+		unsigned horizon = std::max(1u, interval / 4);
+		float refShort = -1e18f;
+		for (unsigned ot = t-std::min(t, horizon-1); ot <= t; ++ot) refShort = std::max(refShort, signal[ot]);
+		if (refShort != max_class.query(horizon) || refShort != max_class.query_since(t-std::min(t, horizon-1)))
+		{
+			std::cout << "      (horizon query inconsistent at t=" << t
+				<< ": wedge-max=" << max_class.query(horizon) << ", actual=" << refShort
+				<< std::endl;
+			success = false;
+		}
+		if (refMin != min_samples.front() || refMax != max_samples.front()
+			|| signal[min_samples.arg_extremum()] != refMin || signal[max_samples.arg_extremum()] != refMax
+			|| signal[minmax.min_time()] != refMin || signal[t - max_samples.age()] != refMax)
+		{
+			std::cout << "      (sample wedge inconsistent at t=" << t
+				<< ": wedge-min=" << min_samples.front() << ", wedge-max=" << max_samples.front()
+				<< std::endl;
+			success = false;
+		}
+		if (refMin != min_records.front_value().value || refMagnitude != magnitude(max_magnitude.front_value()))
+		{
+			std::cout << "      (projected wedge inconsistent at t=" << t << ")" << std::endl;
+			success = false;
+		}
+		if (refMin != storeKey(min_handles.front()) || refMax != storeKey(max_handles.front()))
+		{
+			std::cout << "      (handle wedge inconsistent at t=" << t << ")" << std::endl;
+			success = false;
+		}
+		if (refMin != minmax.min() || refMax != minmax.max() || refMax - refMin != minmax.range())
+		{
+			std::cout << "      (minmax inconsistent at t=" << t
+				<< ": wedge-min=" << minmax.min() << ", wedge-max=" << minmax.max()
+				<< std::endl;
+			success = false;
+		}
+	}
+	
+	// Check the van Herk / Gil-Werman kernel, also on quantized copies of the signal
+	success &= test_van_herk<float>(signal, interval, refMins, refMaxs, [](float v) {return v;}, "float");
+	success &= test_van_herk<double>(signal, interval, refMins, refMaxs, [](float v) {return double(v);}, "double");
+	success &= test_van_herk<int32_t>(signal, interval, refMins, refMaxs,
+		[](float v) {return int32_t(std::floor(v*256.f));}, "int32");
+	success &= test_van_herk<int16_t>(signal, interval, refMins, refMaxs,
+		[](float v) {return int16_t(std::max(-32768.f, std::min(32767.f, std::floor(v*64.f))));}, "int16");
+	
+	// Check a cascade against exact rolling maxima of the window and of the window plus one bucket;
+	//   windows whose oldest sample starts a bucket must be answered exactly
+	{
+		cascade_wedge<unsigned, float> cascade(64);
+		cascade.add_level(16, 1024);
+		cascade.add_level(256, 8192);
+		
+		const unsigned windows[] = {48, 700, 5000}, buckets[] = {0, 16, 256};
+		std::vector<float> inner[3], outer[3];
+		for (unsigned w = 0; w < 3; ++w)
+		{
+			inner[w].resize(signal.size());
+			outer[w].resize(signal.size());
+			rolling_max(signal.data(), inner[w].data(), signal.size(), windows[w]);
+			rolling_max(signal.data(), outer[w].data(), signal.size(), windows[w] + buckets[w]);
+		}
+		
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			cascade.update(t, signal[t]);
+			for (unsigned w = 0; w < 3; ++w)
+			{
+				float result = cascade.query(windows[w]);
+				bool  exact  = !buckets[w] || t + 1 < windows[w] || (t + 1 - windows[w]) % buckets[w] == 0;
+				if (result < inner[w][t] || result > outer[w][t] || (exact && result != inner[w][t]))
+				{
+					std::cout << "      (cascade inconsistent at t=" << t << ", window=" << windows[w]
+						<< ": cascade-max=" << result << ", actual=" << inner[w][t] << ")" << std::endl;
+					success = false;
+				}
+			}
+		}
+	}
+	
+	// Feed the signal in blocks through the batch interface
+	{
+		const unsigned block = 256;
+		std::vector<unsigned> times(signal.size()), gapped_times(signal.size());
+		for (unsigned t = 0; t < times.size(); ++t) times[t] = t;
+		
+		// With a work limit and gaps in time, expired samples may remain in the rings between updates
+		for (unsigned t = 0; t < times.size(); ++t) gapped_times[t] = t + (t / 64) * (interval / 4);
+		
+		::mono_wedge::mono_wedge<unsigned, float> max_batch(interval), min_batch(interval), rt_min_batch(interval);
+		std::vector<float> rolling_min(block), rt_rolling_min(block);
+		rt_min_batch.set_work_limit(1);
+		
+		for (unsigned start = 0; start < signal.size(); start += block)
+		{
+			unsigned n = std::min<unsigned>(block, unsigned(signal.size()) - start);
+			max_batch.max_update_batch(&times[start], &signal[start], n);
+			min_batch.min_update_batch(&times[start], &signal[start], n, &rolling_min[0]);
+			rt_min_batch.min_update_batch(&gapped_times[start], &signal[start], n, &rt_rolling_min[0]);
+			
+			for (unsigned t = start; t < start+n; ++t)
+			{
+				float refMin = 1e18f, refMax = -1e18f, refGappedMin = 1e18f;
+				for (unsigned ot = t-std::min(t, interval-1); ot <= t; ++ot)
+				{
+					refMin = std::min(refMin, signal[ot]);
+					refMax = std::max(refMax, signal[ot]);
+				}
+				for (unsigned ot = t + 1; ot-- > 0 && gapped_times[t] - gapped_times[ot] < interval;)
+					refGappedMin = std::min(refGappedMin, signal[ot]);
+				if (refMin != rolling_min[t-start] || refGappedMin != rt_rolling_min[t-start]
+					|| (t == start+n-1 && refMax != max_batch.front_value()))
+				{
+					std::cout << "      (batch inconsistent at t=" << t << ")" << std::endl;
+					success = false;
+				}
+			}
+		}
+	}
+	
+	// Real-time profile, which must not allocate after construction
+	{
+		fixed_wedge<unsigned, float> fixedMin(interval), fixedMax(interval);
+		static_wedge<unsigned, float, 4096> staticMax(interval);
+		unsigned long allocations = allocationCount;
+		
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			fixedMin.min_update(t, signal[t]);
+			fixedMax.max_update(t, signal[t]);
+			staticMax.max_update(t, signal[t]);
+			if (fixedMin.front_value() != refMins[t] || fixedMax.front_value() != refMaxs[t]
+				|| staticMax.front_value() != refMaxs[t])
+			{
+				std::cout << "      (fixed wedge inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+		if (allocationCount != allocations)
+		{
+			std::cout << "      (fixed wedge allocated " << (allocationCount - allocations) << " times)" << std::endl;
+			success = false;
+		}
+	}
+	
+	// Wedge in growable rings, which must release their storage once drained
+	{
+		::mono_wedge::mono_wedge<unsigned, float, void, growable_storage> growableMin(interval);
+		size_t initialCapacity = growableMin.capacity();
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			growableMin.min_update(t, signal[t]);
+			if (growableMin.front_value() != refMins[t])
+			{
+				std::cout << "      (growable wedge inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+		growableMin.expire_before(unsigned(signal.size()));
+		if (!growableMin.empty() || growableMin.capacity() > initialCapacity)
+		{
+			std::cout << "      (growable wedge kept capacity " << growableMin.capacity() << " when drained)" << std::endl;
+			success = false;
+		}
+	}
+	
+	// Wedges with inline storage, which may allocate only once deeper than their inline capacity
+	{
+		static_assert(sizeof(small_wedge<unsigned, float, 8>) <= 128, "small_wedge of 8 samples exceeds two cache lines");
+		
+		::mono_wedge::mono_wedge<unsigned, float, void, inline_storage<8> > inlineMax(interval);
+		small_wedge<unsigned, float, 8> smallMin(interval), smallMax(interval);
+		unsigned long allocations = allocationCount;
+		size_t peakSize = 0;
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			inlineMax.max_update(t, signal[t]);
+			smallMin.min_update(t, signal[t]);
+			smallMax.max_update(t, signal[t]);
+			peakSize = std::max(peakSize, std::max(inlineMax.size(), smallMin.size()));
+			if (inlineMax.front_value() != refMaxs[t] || smallMin.front_value() != refMins[t]
+				|| smallMax.front_value() != refMaxs[t])
+			{
+				std::cout << "      (inline wedge inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+		if ((allocationCount != allocations) != (peakSize > 8))
+		{
+			std::cout << "      (inline wedge of depth " << peakSize << " allocated "
+				<< (allocationCount - allocations) << " times)" << std::endl;
+			success = false;
+		}
+	}
+	
+#if MONO_WEDGE_MIRRORED_RINGBUFFER
+	// Wedge in mirrored rings, whose contents stay contiguous as they wrap around
+	{
+		::mono_wedge::mono_wedge<unsigned, float, void, mirrored_storage> mirroredMax(interval);
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			mirroredMax.max_update(t, signal[t]);
+			if (mirroredMax.front_value() != refMaxs[t]
+				|| &mirroredMax.back_value() != &mirroredMax.front_value() + (mirroredMax.size() - 1))
+			{
+				std::cout << "      (mirrored wedge inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+	}
+	
+#endif
+	// Move samples with payloads into a wedge, which must not copy them
+	{
+		::mono_wedge::mono_wedge<unsigned, Labeled, float> labeledMax(interval);
+		Labeled::copies = 0;
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			labeledMax.max_update(t, Labeled(signal[t]), &Labeled::value);
+			const Labeled &front = labeledMax.front_value();
+			if (front.value != refMaxs[t] || front.payload.size() != 8 || front.payload[7] != front.value)
+			{
+				std::cout << "      (moved wedge inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+		if (Labeled::copies)
+		{
+			std::cout << "      (moved wedge copied " << Labeled::copies << " samples)" << std::endl;
+			success = false;
+		}
+	}
+	
+	// Track the four largest values against a multiset of the window
+	{
+		topk_wedge<unsigned, float, 4> top4(interval);
+		std::multiset<float> window;
+		
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			if (t >= interval) window.erase(window.find(signal[t - interval]));
+			window.insert(signal[t]);
+			top4.update(t, signal[t]);
+			
+			float top[4];
+			unsigned count = unsigned(top4.top(top));
+			bool match = (count == std::min<size_t>(4, window.size()) && top[0] == top4.front());
+			auto ref = window.rbegin();
+			for (unsigned i = 0; match && i < count; ++i, ++ref) match = (top[i] == *ref);
+			if (!match)
+			{
+				std::cout << "      (top-k inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+	}
+	
+	// Aggregate the window maximum, and an exact sum of the quantized signal
+	{
+		auto maxOp = [](float a, float b) {return std::max(a, b);};
+		auto sumOp = [](long long a, long long b) {return a + b;};
+		window_aggregate<float, decltype(maxOp)> maxAggregate(maxOp);
+		window_aggregate<long long, decltype(sumOp)> sumAggregate(sumOp);
+		long long refSum = 0;
+		
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			long long quantized = (long long)std::floor(signal[t]*1024.f);
+			if (t >= interval)
+			{
+				maxAggregate.pop_front();
+				sumAggregate.pop_front();
+				refSum -= (long long)std::floor(signal[t - interval]*1024.f);
+			}
+			maxAggregate.push_back(signal[t]);
+			sumAggregate.push_back(quantized);
+			refSum += quantized;
+			
+			if (maxAggregate.query() != refMaxs[t] || sumAggregate.query() != refSum)
+			{
+				std::cout << "      (aggregate inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
+	}
+	
+	// Concatenate labels over a short window, which checks the order of a non-commutative operation
+	{
+		auto concatOp = [](const std::string &a, const std::string &b) {return a + b;};
+		window_aggregate<std::string, decltype(concatOp)> concatAggregate(concatOp);
+		const unsigned window = std::min(interval, 64u);
+		std::string labels;
+		
+		for (unsigned t = 0; t < signal.size(); ++t)
+		{
+			labels.push_back(char('a' + (signal[t] > refMins[t]) + 2*(t % 13)));
+			if (t >= window) concatAggregate.pop_front();
+			concatAggregate.push_back(labels.substr(t));
+			
+			if (concatAggregate.query() != labels.substr(t + 1 - std::min(t + 1, window)))
+			{
+				std::cout << "      (concatenation inconsistent at t=" << t << ")" << std::endl;
+				success = false;
+			}
+		}
 	}
 	
 	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
@@ -97,9 +527,176 @@ bool test(const Signal &signal, unsigned interval = 0)
 	return success;
 }
 
+// A windowed wedge fed a batch longer than its window keeps to the storage reserved for the window
+// Popping an empty wedge must leave it empty, even while dead samples are collected lazily
+bool test_empty_pop()
+{
+	bool success = true;
+	
+	::mono_wedge::mono_wedge<unsigned, float> emptied;
+	emptied.set_work_limit(1);
+	emptied.pop_front();
+	emptied.max_update(0, 1.f);
+	emptied.pop_front();
+	emptied.pop_front();
+	emptied.max_update(1, 2.f);
+	if (emptied.size() != 1 || emptied.front_value() != 2.f)
+	{
+		std::cout << "      (popped empty wedge inconsistent)" << std::endl;
+		success = false;
+	}
+	
+	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
+	
+	return success;
+}
+
+// Overflow a descending max-wedge with room for four samples
+bool test_overflow_policies()
+{
+	bool success = true;
+	
+	const unsigned window = 32;
+	
+	fixed_wedge<unsigned, float, overflow::report> reporter(window, 4);
+	fixed_wedge<unsigned, float, overflow::drop_oldest> dropper(window, 4);
+	bool accepted[6];
+	for (unsigned t = 0; t < 6; ++t)
+	{
+		accepted[t] = reporter.max_update(t, -float(t));
+		dropper.max_update(t, -float(t));
+	}
+	if (!accepted[3] || accepted[4] || reporter.back_time() != 3 || dropper.front_time() != 2 || dropper.size() != 4)
+	{
+		std::cout << "      (fixed wedge overflow policy inconsistent)" << std::endl;
+		success = false;
+	}
+	
+	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
+	
+	return success;
+}
+
+// Pop runs from both ends of wrapped rings, with and without destructors to run
+bool test_bulk_pops(const Signal &signal)
+{
+	bool success = true;
+	
+	static_ringbuffer<Tracked, 8> trackedRing(8);
+	fixed_ringbuffer<float>       floatRing(8);
+	std::vector<float>            reference;
+	
+	for (unsigned t = 0; t < signal.size(); ++t)
+	{
+		if (trackedRing.full())
+		{
+			size_t n = 1 + t % 3;
+			trackedRing.pop_front_n(n);
+			floatRing.pop_front_n(n);
+			reference.erase(reference.begin(), reference.begin() + std::min(n, reference.size()));
+		}
+		if (t % 5 == 0)
+		{
+			trackedRing.pop_back_n(2);
+			floatRing.pop_back_n(2);
+			reference.resize(reference.size() - std::min<size_t>(2, reference.size()));
+		}
+		trackedRing.push_back(Tracked(signal[t]));
+		floatRing.push_back(signal[t]);
+		reference.push_back(signal[t]);
+		
+		bool match = (trackedRing.size() == reference.size() && floatRing.size() == reference.size()
+			&& Tracked::live == long(reference.size()));
+		for (size_t i = 0; match && i < reference.size(); ++i)
+			match = (trackedRing[i].value == reference[i] && floatRing[i] == reference[i]);
+		if (!match)
+		{
+			std::cout << "      (bulk pops inconsistent at t=" << t << ")" << std::endl;
+			success = false;
+		}
+	}
+	
+	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
+	
+	return success;
+}
+
+// Stream the signal through small rings in blocks, which wrap around their ends;  the small_ringbuffer spills
+bool test_block_transfers(const Signal &signal)
+{
+	bool success = true;
+	
+	fixed_ringbuffer<float>    blockRing(16);
+	small_ringbuffer<float, 4> smallRing;
+	std::vector<float>         streamed(signal.size()), smallStreamed(signal.size());
+	size_t                     written = 0, read = 0;
+	bool                       smallCounts = true;
+	
+	while (read < signal.size())
+	{
+		size_t n = std::min<size_t>(1 + written % 7, signal.size() - written);
+		if (n <= blockRing.capacity() - blockRing.size())
+		{
+			blockRing.push_back_n(&signal[written], n);
+			smallRing.push_back_n(&signal[written], n);
+			written += n;
+		}
+#if defined(__cpp_lib_span)
+		auto spans = blockRing.as_spans();
+		if (spans.first.size() + spans.second.size() != blockRing.size()
+			|| (!blockRing.empty() && &spans.first.front() != &blockRing.front())
+			|| (!spans.second.empty() && &spans.second.back() != &blockRing.back()))
+		{
+			std::cout << "      (ring spans inconsistent at sample " << read << ")" << std::endl;
+			success = false;
+		}
+#endif
+		size_t popped = blockRing.pop_front_n(&streamed[read], 1 + read % 5);
+		smallCounts = smallCounts && (smallRing.pop_front_n(&smallStreamed[read], popped) == popped);
+		read += popped;
+	}
+	if (streamed != signal || smallStreamed != signal || !smallCounts)
+	{
+		std::cout << "      (block transfers inconsistent)" << std::endl;
+		success = false;
+	}
+	
+	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
+	
+	return success;
+}
+
+bool test_batch_storage()
+{
+	bool success = true;
+	
+	const int window = 32, length = 256;
+	::mono_wedge::mono_wedge<int, float> batchWedge(window), singleWedge(window);
+	batchWedge.reserve(window);
+	singleWedge.reserve(window);
+	
+	std::vector<int>   times(length);
+	std::vector<float> values(length);
+	for (int t = 0; t < length; ++t) {times[t] = t; values[t] = -float(t);}
+	
+	batchWedge.max_update_batch(times.data(), values.data(), times.size());
+	for (int t = 0; t < length; ++t) singleWedge.max_update(times[t], values[t]);
+	
+	if (batchWedge.capacity() != size_t(window) || batchWedge.size() != singleWedge.size()
+		|| batchWedge.front_time() != singleWedge.front_time())
+	{
+		std::cout << "      (batch grew to capacity " << batchWedge.capacity() << " for a window of " << window << ")" << std::endl;
+		success = false;
+	}
+	
+	std::cout << "      " << (success ? "...OK" : "...FAILED") << std::endl;
+	
+	return success;
+}
+
 int main(int argc, const char * argv[])
 {
-	Signal white, brown, red, whiteUp, whiteDn, sine, square, noisySine;
+	Signal white, brown, red, whiteUp, whiteDn, sine, square, noisySine, ramp;
 	
 	std::cout << "Synthesizing test signals..." << std::endl;
 	
@@ -122,6 +719,7 @@ int main(int argc, const char * argv[])
 		sine   .push_back(sineC);
 		square .push_back((i&64u) ? 1.0f : -1.0f);
 		noisySine.push_back(sineC+randC);
+		ramp   .push_back(-.01f * float(i));
 		
 		randP = randC;
 	}
@@ -143,22 +741,35 @@ int main(int argc, const char * argv[])
 		std::cout << "  Interval = " << interval << std::endl;
 		
 		std::cout << "    White:" << std::endl;
-		success &= test(white);
+		success &= test(white, interval);
 		std::cout << "    White ascending:" << std::endl;
-		success &= test(whiteUp);
+		success &= test(whiteUp, interval);
 		std::cout << "    White descending:" << std::endl;
-		success &= test(whiteDn);
+		success &= test(whiteDn, interval);
 		std::cout << "    Brown:" << std::endl;
-		success &= test(brown);
+		success &= test(brown, interval);
 		std::cout << "    Red:" << std::endl;
-		success &= test(red);
+		success &= test(red, interval);
 		std::cout << "    Sine:" << std::endl;
-		success &= test(sine);
+		success &= test(sine, interval);
 		std::cout << "    Square:" << std::endl;
-		success &= test(square);
+		success &= test(square, interval);
 		std::cout << "    Noisy Sine:" << std::endl;
-		success &= test(noisySine);
+		success &= test(noisySine, interval);
+		std::cout << "    Falling ramp:" << std::endl;
+		success &= test(ramp, interval);
 	}
 	
+	std::cout << "  Empty pops:" << std::endl;
+	success &= test_empty_pop();
+	std::cout << "  Overflow policies:" << std::endl;
+	success &= test_overflow_policies();
+	std::cout << "  Bulk pops:" << std::endl;
+	success &= test_bulk_pops(white);
+	std::cout << "  Block transfers:" << std::endl;
+	success &= test_block_transfers(white);
+	std::cout << "  Batch storage:" << std::endl;
+	success &= test_batch_storage();
+	
 	return success ? 0 : 1;
 }
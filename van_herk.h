@@ -0,0 +1,384 @@
+#ifndef VAN_HERK_H
+#define VAN_HERK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define VAN_HERK_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Compiles a function for the given instruction set, whatever the build's flags.  MSVC needs no attribute.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define VAN_HERK_TARGET(isa)
+#else
+#define VAN_HERK_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+/*
+        This header presents the van Herk / Gil-Werman algorithm for rolling
+                minimum and maximum over a dense array with a window fixed in samples.
+
+        It is an alternative engine to mono_wedge.h for offline and block
+                processing.  Where the wedge's cost depends on the data, this kernel
+                performs exactly three comparisons per sample without branches:
+
+                - The input is split into blocks of window samples.
+                - A forward scan computes each sample's prefix extremum in its block.
+                - A backward scan computes each sample's suffix extremum in its block.
+                - The window ending at sample i is the combination of the suffix at
+                  i-window+1 and the prefix at i, which straddle one block boundary.
+
+        On x86 the final combination pass is vectorized for float, double, int16_t
+                and int32_t.  Each instruction set (SSE2, AVX2, and AVX-512 with the F
+                and BW extensions) has its own kernel, compiled for it regardless of
+                the build's flags, and the widest one the CPU supports is chosen once
+                at run time.  Other types and targets use a scalar loop.
+
+        Results match a wedge which pops samples older than window:  out[i] is the
+                extremum of in[max(0, i-window+1) .. i].  NaN inputs give unspecified
+                results.
+*/
+
+namespace mono_wedge {
+namespace detail {
+struct min_op {
+  static const bool minimum = true;
+
+  template <class T>
+  T operator()(const T& a, const T& b) const { return b < a ? b : a; }
+};
+
+struct max_op {
+  static const bool minimum = false;
+
+  template <class T>
+  T operator()(const T& a, const T& b) const { return a < b ? b : a; }
+};
+
+// Instruction sets with a combination kernel, in order of preference.
+enum isa_level { isa_scalar, isa_sse2, isa_avx2, isa_avx512 };
+
+struct sse2 {};
+struct avx2 {};
+struct avx512 {};
+
+/*
+        simd<T, ISA> describes the vector registers used for T with an
+                instruction set, if any.  A width of zero selects the scalar loop.
+*/
+template <class T, class ISA>
+struct simd {
+  enum { width = 0 };
+};
+
+#if defined(VAN_HERK_X86)
+template <>
+struct simd<float, sse2> {
+  typedef __m128 reg;
+  enum { width = 4 };
+  VAN_HERK_TARGET("sse2") static reg load(const float* p) { return _mm_loadu_ps(p); }
+  VAN_HERK_TARGET("sse2") static void store(float* p, reg r) { _mm_storeu_ps(p, r); }
+  VAN_HERK_TARGET("sse2") static reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+  VAN_HERK_TARGET("sse2") static reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+};
+
+template <>
+struct simd<double, sse2> {
+  typedef __m128d reg;
+  enum { width = 2 };
+  VAN_HERK_TARGET("sse2") static reg load(const double* p) { return _mm_loadu_pd(p); }
+  VAN_HERK_TARGET("sse2") static void store(double* p, reg r) { _mm_storeu_pd(p, r); }
+  VAN_HERK_TARGET("sse2") static reg min(reg a, reg b) { return _mm_min_pd(a, b); }
+  VAN_HERK_TARGET("sse2") static reg max(reg a, reg b) { return _mm_max_pd(a, b); }
+};
+
+// SSE2 has no 32-bit integer min or max, so these select through a comparison mask.
+template <>
+struct simd<std::int32_t, sse2> {
+  typedef __m128i reg;
+  enum { width = 4 };
+  VAN_HERK_TARGET("sse2") static reg load(const std::int32_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const reg*>(p));
+  }
+  VAN_HERK_TARGET("sse2") static void store(std::int32_t* p, reg r) { _mm_storeu_si128(reinterpret_cast<reg*>(p), r); }
+  VAN_HERK_TARGET("sse2") static reg select(reg mask, reg a, reg b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+  VAN_HERK_TARGET("sse2") static reg min(reg a, reg b) { return select(_mm_cmpgt_epi32(a, b), b, a); }
+  VAN_HERK_TARGET("sse2") static reg max(reg a, reg b) { return select(_mm_cmpgt_epi32(a, b), a, b); }
+};
+
+template <>
+struct simd<std::int16_t, sse2> {
+  typedef __m128i reg;
+  enum { width = 8 };
+  VAN_HERK_TARGET("sse2") static reg load(const std::int16_t* p) {
+    return _mm_loadu_si128(reinterpret_cast<const reg*>(p));
+  }
+  VAN_HERK_TARGET("sse2") static void store(std::int16_t* p, reg r) { _mm_storeu_si128(reinterpret_cast<reg*>(p), r); }
+  VAN_HERK_TARGET("sse2") static reg min(reg a, reg b) { return _mm_min_epi16(a, b); }
+  VAN_HERK_TARGET("sse2") static reg max(reg a, reg b) { return _mm_max_epi16(a, b); }
+};
+
+template <>
+struct simd<float, avx2> {
+  typedef __m256 reg;
+  enum { width = 8 };
+  VAN_HERK_TARGET("avx2") static reg load(const float* p) { return _mm256_loadu_ps(p); }
+  VAN_HERK_TARGET("avx2") static void store(float* p, reg r) { _mm256_storeu_ps(p, r); }
+  VAN_HERK_TARGET("avx2") static reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+  VAN_HERK_TARGET("avx2") static reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+};
+
+template <>
+struct simd<double, avx2> {
+  typedef __m256d reg;
+  enum { width = 4 };
+  VAN_HERK_TARGET("avx2") static reg load(const double* p) { return _mm256_loadu_pd(p); }
+  VAN_HERK_TARGET("avx2") static void store(double* p, reg r) { _mm256_storeu_pd(p, r); }
+  VAN_HERK_TARGET("avx2") static reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+  VAN_HERK_TARGET("avx2") static reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+};
+
+template <>
+struct simd<std::int32_t, avx2> {
+  typedef __m256i reg;
+  enum { width = 8 };
+  VAN_HERK_TARGET("avx2") static reg load(const std::int32_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const reg*>(p));
+  }
+  VAN_HERK_TARGET("avx2") static void store(std::int32_t* p, reg r) {
+    _mm256_storeu_si256(reinterpret_cast<reg*>(p), r);
+  }
+  VAN_HERK_TARGET("avx2") static reg min(reg a, reg b) { return _mm256_min_epi32(a, b); }
+  VAN_HERK_TARGET("avx2") static reg max(reg a, reg b) { return _mm256_max_epi32(a, b); }
+};
+
+template <>
+struct simd<std::int16_t, avx2> {
+  typedef __m256i reg;
+  enum { width = 16 };
+  VAN_HERK_TARGET("avx2") static reg load(const std::int16_t* p) {
+    return _mm256_loadu_si256(reinterpret_cast<const reg*>(p));
+  }
+  VAN_HERK_TARGET("avx2") static void store(std::int16_t* p, reg r) {
+    _mm256_storeu_si256(reinterpret_cast<reg*>(p), r);
+  }
+  VAN_HERK_TARGET("avx2") static reg min(reg a, reg b) { return _mm256_min_epi16(a, b); }
+  VAN_HERK_TARGET("avx2") static reg max(reg a, reg b) { return _mm256_max_epi16(a, b); }
+};
+
+// The AVX-512 min and max are the masked forms under a full mask; the unmasked ones pass an undefined
+//   source, which GCC 12 reports as uninitialized.
+template <>
+struct simd<float, avx512> {
+  typedef __m512 reg;
+  enum { width = 16 };
+  VAN_HERK_TARGET("avx512f") static reg load(const float* p) { return _mm512_loadu_ps(p); }
+  VAN_HERK_TARGET("avx512f") static void store(float* p, reg r) { _mm512_storeu_ps(p, r); }
+  VAN_HERK_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_mask_min_ps(a, __mmask16(-1), a, b); }
+  VAN_HERK_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_mask_max_ps(a, __mmask16(-1), a, b); }
+};
+
+template <>
+struct simd<double, avx512> {
+  typedef __m512d reg;
+  enum { width = 8 };
+  VAN_HERK_TARGET("avx512f") static reg load(const double* p) { return _mm512_loadu_pd(p); }
+  VAN_HERK_TARGET("avx512f") static void store(double* p, reg r) { _mm512_storeu_pd(p, r); }
+  VAN_HERK_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_mask_min_pd(a, __mmask8(-1), a, b); }
+  VAN_HERK_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_mask_max_pd(a, __mmask8(-1), a, b); }
+};
+
+template <>
+struct simd<std::int32_t, avx512> {
+  typedef __m512i reg;
+  enum { width = 16 };
+  VAN_HERK_TARGET("avx512f") static reg load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+  VAN_HERK_TARGET("avx512f") static void store(std::int32_t* p, reg r) { _mm512_storeu_si512(p, r); }
+  VAN_HERK_TARGET("avx512f") static reg min(reg a, reg b) { return _mm512_mask_min_epi32(a, __mmask16(-1), a, b); }
+  VAN_HERK_TARGET("avx512f") static reg max(reg a, reg b) { return _mm512_mask_max_epi32(a, __mmask16(-1), a, b); }
+};
+
+template <>
+struct simd<std::int16_t, avx512> {
+  typedef __m512i reg;
+  enum { width = 32 };
+  VAN_HERK_TARGET("avx512f,avx512bw") static reg load(const std::int16_t* p) { return _mm512_loadu_si512(p); }
+  VAN_HERK_TARGET("avx512f,avx512bw") static void store(std::int16_t* p, reg r) { _mm512_storeu_si512(p, r); }
+  VAN_HERK_TARGET("avx512f,avx512bw") static reg min(reg a, reg b) { return _mm512_min_epi16(a, b); }
+  VAN_HERK_TARGET("avx512f,avx512bw") static reg max(reg a, reg b) { return _mm512_max_epi16(a, b); }
+};
+
+// The widest instruction set which both the CPU and the operating system support.
+inline isa_level detect_isa() {
+#if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0);
+  int leaves = regs[0];
+  __cpuid(regs, 1);
+  bool has_sse2 = (regs[3] >> 26) & 1, has_xgetbv = (regs[2] >> 27) & 1;
+  unsigned long long xcr0 = has_xgetbv ? _xgetbv(0) : 0;
+  int features = 0;
+  if (leaves >= 7) {
+    __cpuidex(regs, 7, 0);
+    features = regs[1];
+  }
+  if ((xcr0 & 0xe6) == 0xe6 && ((features >> 16) & 1) && ((features >> 30) & 1)) return isa_avx512;
+  if ((xcr0 & 0x6) == 0x6 && ((features >> 5) & 1)) return isa_avx2;
+  return has_sse2 ? isa_sse2 : isa_scalar;
+#else
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return isa_avx512;
+  if (__builtin_cpu_supports("avx2")) return isa_avx2;
+  return __builtin_cpu_supports("sse2") ? isa_sse2 : isa_scalar;
+#endif
+}
+
+inline isa_level cpu_isa() {
+  static const isa_level level = detect_isa();
+  return level;
+}
+#else
+inline isa_level cpu_isa() { return isa_scalar; }
+#endif
+
+// out[i] = op(lhs[i], out[i]) for i in [0, n).
+template <class T, class Op>
+void combine(const T* lhs, T* out, size_t n, Op op, std::false_type) {
+  for (size_t i = 0; i < n; ++i) out[i] = op(lhs[i], out[i]);
+}
+
+#if defined(VAN_HERK_X86)
+// One kernel per instruction set, each compiled for it so that its vector loop inlines the intrinsics.
+template <class T, class Op>
+VAN_HERK_TARGET("sse2") void combine_sse2(const T* lhs, T* out, size_t n, Op op) {
+  typedef simd<T, sse2> V;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    typename V::reg a = V::load(lhs + i), b = V::load(out + i);
+    V::store(out + i, Op::minimum ? V::min(a, b) : V::max(a, b));
+  }
+  combine(lhs + i, out + i, n - i, op, std::false_type());
+}
+
+template <class T, class Op>
+VAN_HERK_TARGET("avx2") void combine_avx2(const T* lhs, T* out, size_t n, Op op) {
+  typedef simd<T, avx2> V;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    typename V::reg a = V::load(lhs + i), b = V::load(out + i);
+    V::store(out + i, Op::minimum ? V::min(a, b) : V::max(a, b));
+  }
+  combine(lhs + i, out + i, n - i, op, std::false_type());
+}
+
+template <class T, class Op>
+VAN_HERK_TARGET("avx512f,avx512bw") void combine_avx512(const T* lhs, T* out, size_t n, Op op) {
+  typedef simd<T, avx512> V;
+  size_t i = 0;
+  for (; i + V::width <= n; i += V::width) {
+    typename V::reg a = V::load(lhs + i), b = V::load(out + i);
+    V::store(out + i, Op::minimum ? V::min(a, b) : V::max(a, b));
+  }
+  combine(lhs + i, out + i, n - i, op, std::false_type());
+}
+#endif
+
+template <class T, class Op>
+void combine(const T* lhs, T* out, size_t n, Op op, std::true_type) {
+#if defined(VAN_HERK_X86)
+  switch (cpu_isa()) {
+    case isa_avx512: return combine_avx512(lhs, out, n, op);
+    case isa_avx2: return combine_avx2(lhs, out, n, op);
+    case isa_sse2: return combine_sse2(lhs, out, n, op);
+    case isa_scalar: break;
+  }
+#endif
+  combine(lhs, out, n, op, std::false_type());
+}
+
+template <class T, class Op>
+void van_herk(const T* in, T* out, size_t n, size_t window, T* scratch, Op op) {
+  if (window == 0) window = 1;
+
+  // Prefix extrema go to out, suffix extrema to scratch.
+  for (size_t start = 0; start < n; start += window) {
+    size_t end = std::min(n, start + window);
+    out[start] = in[start];
+    for (size_t i = start + 1; i < end; ++i) out[i] = op(out[i - 1], in[i]);
+    scratch[end - 1] = in[end - 1];
+    for (size_t i = end - 1; i-- > start;) scratch[i] = op(scratch[i + 1], in[i]);
+  }
+
+  // Windows shorter than the first block are already complete.
+  if (n < window) return;
+  combine(scratch, out + (window - 1), n - (window - 1), op,
+          std::integral_constant<bool, (simd<T, sse2>::width > 0)>());
+}
+}  // namespace detail
+
+/*
+        rolling_min(in, out, n, window)
+        rolling_max(in, out, n, window)
+
+        Write the minimum or maximum of the last window samples at each position
+                of in[0..n) to out[0..n).  The arrays must not overlap.
+
+                The variants taking scratch use it as n elements of working memory;
+                the others allocate it.
+*/
+template <class T>
+void rolling_min(const T* in, T* out, size_t n, size_t window, T* scratch) {
+  detail::van_herk(in, out, n, window, scratch, detail::min_op());
+}
+
+template <class T>
+void rolling_max(const T* in, T* out, size_t n, size_t window, T* scratch) {
+  detail::van_herk(in, out, n, window, scratch, detail::max_op());
+}
+
+template <class T>
+void rolling_min(const T* in, T* out, size_t n, size_t window) {
+  std::vector<T> scratch(n);
+  rolling_min(in, out, n, window, scratch.data());
+}
+
+template <class T>
+void rolling_max(const T* in, T* out, size_t n, size_t window) {
+  std::vector<T> scratch(n);
+  rolling_max(in, out, n, window, scratch.data());
+}
+}  // namespace mono_wedge
+
+#endif  // VAN_HERK_H
+
+/*
+        This code is available under the MIT license:
+
+                Copyright (c) 2016 Evan Balster
+
+                Permission is hereby granted, free of charge, to any person obtaining a copy of this
+                software and associated documentation files (the "Software"), to deal in the Software
+                without restriction, including without limitation the rights to use, copy, modify, merge,
+                publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+                to whom the Software is furnished to do so, subject to the following conditions:
+
+                The above copyright notice and this permission notice shall be included in all copies or
+                substantial portions of the Software.
+
+                THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+                INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+                PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+                FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+                OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+                DEALINGS IN THE SOFTWARE.
+*/
@@ -0,0 +1,158 @@
+#ifndef WINDOW_AGGREGATE_H
+#define WINDOW_AGGREGATE_H
+
+#include <cstddef>
+#include <utility>
+
+#include "stl_ringbuffer.h"
+
+/*
+        This header presents a sliding-window aggregator for any associative
+                operation, such as sum, gcd, bitwise or, or compositions of these.
+
+        Where mono_wedge.h covers only the minimum and maximum, this engine
+                requires only that op(op(a, b), c) == op(a, op(b, c)).  The operation
+                need not be commutative nor have an identity.  Each push_back or
+                pop_front costs O(1) combinations in the worst case, with no
+                amortized rebuilds.
+
+        The algorithm is a deamortized form of the classic two-stack queue:
+
+                - The front of the window holds suffix aggregates, so that the
+                  aggregate of the front to its end is read at once.
+                - The back of the window holds only a running aggregate.
+                - Once the back outgrows the front, the back is frozen and its suffix
+                  aggregates are computed over the following operations, three steps
+                  at a time, from its end back to the front of the window.  Queries
+                  meanwhile combine the old front's aggregate with the frozen total.
+
+                The frozen back always becomes the front before the old front has
+                been popped, so every query combines at most three aggregates.
+
+        Storage grows by doubling when full, like mono_wedge; call reserve with the
+                largest window to keep push_back free of reallocation.
+*/
+
+namespace mono_wedge {
+template <class T, class Op>
+class window_aggregate {
+ public:
+  typedef fixed_ringbuffer<T> TValues;
+  typedef typename TValues::size_type size_type;
+
+  explicit window_aggregate(Op op = Op())
+      : values_(initial_capacity),
+        aggs_(initial_capacity),
+        back_(),
+        mid_(),
+        front_size_(0),
+        frozen_size_(0),
+        pending_(0),
+        op_(op) {}
+
+  // Append a value at the back of the window.
+  void push_back(const T& value) {
+    if (values_.full()) reallocate(2 * values_.capacity());
+    back_ = (back_size() == 0) ? value : op_(back_, value);
+    values_.push_back(value);
+    aggs_.push_back(value);
+    advance();
+  }
+
+  // Remove the oldest value.  The window must not be empty.
+  void pop_front() {
+    values_.pop_front();
+    aggs_.pop_front();
+    --front_size_;
+    if (pending_ && !--pending_) finish_flip();
+    advance();
+  }
+
+  // The aggregate of the window from oldest to latest.  The window must not be empty.
+  T query() const {
+    T result = aggs_.front();
+    if (frozen_size_) result = op_(result, mid_);
+    if (back_size()) result = op_(result, back_);
+    return result;
+  }
+
+  const T& front() const { return values_.front(); }
+  const T& back() const { return values_.back(); }
+
+  bool empty() const { return values_.empty(); }
+  size_type size() const { return values_.size(); }
+
+  void reserve(size_type depth) {
+    if (depth > values_.capacity()) reallocate(depth);
+  }
+
+  void clear() {
+    values_.clear();
+    aggs_.clear();
+    front_size_ = frozen_size_ = pending_ = 0;
+  }
+
+ private:
+  static const size_type initial_capacity = 16;
+  static const size_type steps_per_operation = 3;
+
+  // Positions are relative to the front: the front occupies [0, front_size_), the frozen back the next frozen_size_
+  // values, and the live back the rest.  While flipping, suffix aggregates are complete over [pending_, end of frozen).
+  TValues values_, aggs_;
+  T back_, mid_;
+  size_type front_size_, frozen_size_, pending_;
+  Op op_;
+
+  size_type back_size() const { return values_.size() - front_size_ - frozen_size_; }
+
+  void advance() {
+    if (!frozen_size_ && back_size() > front_size_) {
+      frozen_size_ = back_size();
+      mid_ = back_;
+      pending_ = front_size_ + frozen_size_;
+    }
+    for (size_type step = 0; frozen_size_ && step < steps_per_operation; ++step) {
+      size_type i = --pending_;
+      if (i + 1 < front_size_ + frozen_size_) aggs_[i] = op_(values_[i], aggs_[i + 1]);
+      if (!pending_) finish_flip();
+    }
+  }
+
+  void finish_flip() {
+    front_size_ += frozen_size_;
+    frozen_size_ = 0;
+  }
+
+  void reallocate(size_type depth) {
+    TValues larger_values(depth), larger_aggs(depth);
+    for (auto& value : values_) larger_values.push_back(std::move(value));
+    for (auto& agg : aggs_) larger_aggs.push_back(std::move(agg));
+    values_.swap(larger_values);
+    aggs_.swap(larger_aggs);
+  }
+};
+}  // namespace mono_wedge
+
+#endif  // WINDOW_AGGREGATE_H
+
+/*
+        This code is available under the MIT license:
+
+                Copyright (c) 2016 Evan Balster
+
+                Permission is hereby granted, free of charge, to any person obtaining a copy of this
+                software and associated documentation files (the "Software"), to deal in the Software
+                without restriction, including without limitation the rights to use, copy, modify, merge,
+                publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons
+                to whom the Software is furnished to do so, subject to the following conditions:
+
+                The above copyright notice and this permission notice shall be included in all copies or
+                substantial portions of the Software.
+
+                THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+                INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+                PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+                FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+                OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+                DEALINGS IN THE SOFTWARE.
+*/